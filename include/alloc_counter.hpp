@@ -0,0 +1,194 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+// Replaces the global operator new and operator delete to count heap
+// allocations of the entire process. Include this header in exactly one
+// translation unit per program.
+//
+// The counters add a few atomic operations to each allocation. To keep
+// threads from contending on a single cache line, each thread counts
+// allocations in a slot of its own and each global counter has a cache line
+// of its own. Benchmarks still run slightly slower than without counting.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef __GLIBC__
+#  include <malloc.h>
+#endif
+
+namespace alloc_counter {
+
+constexpr size_t cache_line_size = 64;
+
+/// Allocation counters of the threads that share a slot.
+struct alignas(cache_line_size) slot {
+  /// Number of calls to any operator new.
+  std::atomic<uint64_t> allocations{0};
+  /// Sum of all requested bytes.
+  std::atomic<uint64_t> allocated_bytes{0};
+};
+
+/// Threads pick slots round robin, i.e., only share a slot when running more
+/// threads than there are slots.
+constexpr size_t num_slots = 64;
+
+inline slot slots[num_slots];
+
+inline slot& this_slot() {
+  static std::atomic<size_t> next_slot{0};
+  thread_local size_t index
+    = next_slot.fetch_add(1, std::memory_order_relaxed) % num_slots;
+  return slots[index];
+}
+
+/// Currently allocated bytes (only tracked with glibc).
+alignas(cache_line_size) inline std::atomic<int64_t> live_bytes{0};
+
+/// Maximum of `live_bytes` since the last call to `reset_peak`.
+alignas(cache_line_size) inline std::atomic<int64_t> peak_bytes{0};
+
+/// A point-in-time copy of all counters.
+struct snapshot {
+  uint64_t allocations;
+  uint64_t allocated_bytes;
+  int64_t live_bytes;
+};
+
+inline snapshot now() {
+  snapshot result{0, 0, live_bytes.load(std::memory_order_relaxed)};
+  for (auto& x : slots) {
+    result.allocations += x.allocations.load(std::memory_order_relaxed);
+    result.allocated_bytes += x.allocated_bytes.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+/// Sets the peak to the current number of live bytes.
+inline void reset_peak() {
+  peak_bytes = live_bytes.load(std::memory_order_relaxed);
+}
+
+inline void on_alloc(void* ptr, size_t size) {
+  auto& counters = this_slot();
+  counters.allocations.fetch_add(1, std::memory_order_relaxed);
+  counters.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+#ifdef __GLIBC__
+  auto n = static_cast<int64_t>(malloc_usable_size(ptr));
+  auto live = live_bytes.fetch_add(n, std::memory_order_relaxed) + n;
+  auto peak = peak_bytes.load(std::memory_order_relaxed);
+  while (live > peak
+         && !peak_bytes.compare_exchange_weak(peak, live,
+                                              std::memory_order_relaxed)) {
+    // repeat
+  }
+#else
+  static_cast<void>(ptr);
+#endif
+}
+
+inline void on_free(void* ptr) {
+#ifdef __GLIBC__
+  if (ptr != nullptr)
+    live_bytes.fetch_sub(static_cast<int64_t>(malloc_usable_size(ptr)),
+                         std::memory_order_relaxed);
+#else
+  static_cast<void>(ptr);
+#endif
+}
+
+inline void* allocate(size_t size) {
+  if (size == 0)
+    size = 1;
+  auto ptr = malloc(size);
+  if (ptr == nullptr)
+    throw std::bad_alloc{};
+  on_alloc(ptr, size);
+  return ptr;
+}
+
+inline void* allocate(size_t size, std::align_val_t alignment) {
+  void* ptr = nullptr;
+  auto align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+  if (posix_memalign(&ptr, align, size == 0 ? 1 : size) != 0)
+    throw std::bad_alloc{};
+  on_alloc(ptr, size);
+  return ptr;
+}
+
+inline void deallocate(void* ptr) noexcept {
+  on_free(ptr);
+  free(ptr);
+}
+
+} // namespace alloc_counter
+
+void* operator new(size_t size) {
+  return alloc_counter::allocate(size);
+}
+
+void* operator new[](size_t size) {
+  return alloc_counter::allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return alloc_counter::allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return alloc_counter::allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  return alloc_counter::allocate(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return alloc_counter::allocate(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+  alloc_counter::deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  alloc_counter::deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  alloc_counter::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  alloc_counter::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  alloc_counter::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+  alloc_counter::deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+  alloc_counter::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+  alloc_counter::deallocate(ptr);
+}
+
+#endif // ALLOC_COUNTER_HPP
@@ -0,0 +1,28 @@
+#ifndef BENCH_ARGS_HPP
+#define BENCH_ARGS_HPP
+
+#include <cstring>
+#include <optional>
+#include <string>
+
+/// Removes the first argument of the form `--NAME=VALUE` from the command line
+/// and returns `VALUE`. Allows programs with positional arguments to accept
+/// optional flags at any position.
+inline std::optional<std::string> take_arg(int& argc, char** argv,
+                                           const char* name) {
+  auto len = strlen(name);
+  for (int i = 1; i < argc; ++i) {
+    auto arg = argv[i];
+    if (strncmp(arg, "--", 2) == 0 && strncmp(arg + 2, name, len) == 0
+        && arg[len + 2] == '=') {
+      std::string result = arg + len + 3;
+      for (int j = i + 1; j < argc; ++j)
+        argv[j - 1] = argv[j];
+      argv[--argc] = nullptr;
+      return result;
+    }
+  }
+  return std::nullopt;
+}
+
+#endif // BENCH_ARGS_HPP
@@ -0,0 +1,68 @@
+#ifndef BENCHMARK_COUNTERS_HPP
+#define BENCHMARK_COUNTERS_HPP
+
+// Replaces the global operator new (via alloc_counter.hpp), i.e., include this
+// header in exactly one translation unit per program.
+
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+#include "alloc_counter.hpp"
+
+/// Adds the counters `elements/s`, `allocs/element` and optionally `bytes/s`
+/// to a Google Benchmark run. Construct before the benchmark loop and call
+/// `report` after it.
+class element_counters {
+public:
+  element_counters() : allocations_(alloc_counter::now().allocations) {
+    // nop
+  }
+
+  /// Reports the counters for `per_iteration` elements in each iteration.
+  /// Also reports `bytes/s` if `bytes_per_element` is not 0.
+  void report(benchmark::State& state, uint64_t per_iteration,
+              uint64_t bytes_per_element = 0) {
+    auto elements = per_iteration * static_cast<uint64_t>(state.iterations());
+    auto allocations = alloc_counter::now().allocations - allocations_;
+    state.counters["elements/s"]
+      = benchmark::Counter(static_cast<double>(elements),
+                           benchmark::Counter::kIsRate);
+    state.counters["allocs/element"]
+      = elements > 0 ? static_cast<double>(allocations) / elements : 0.0;
+    if (bytes_per_element > 0)
+      state.counters["bytes/s"]
+        = benchmark::Counter(static_cast<double>(elements * bytes_per_element),
+                             benchmark::Counter::kIsRate);
+  }
+
+private:
+  uint64_t allocations_;
+};
+
+/// Adds the counters `allocs/op` and `alloc_bytes/op` to a Google Benchmark
+/// run, where each iteration performs one operation. Construct before the
+/// benchmark loop and call `report` after it.
+class operation_counters {
+public:
+  operation_counters() : start_(alloc_counter::now()) {
+    // nop
+  }
+
+  void report(benchmark::State& state) {
+    auto stop = alloc_counter::now();
+    auto ops = static_cast<double>(state.iterations());
+    if (ops == 0)
+      return;
+    state.counters["allocs/op"]
+      = static_cast<double>(stop.allocations - start_.allocations) / ops;
+    state.counters["alloc_bytes/op"]
+      = static_cast<double>(stop.allocated_bytes - start_.allocated_bytes)
+        / ops;
+  }
+
+private:
+  alloc_counter::snapshot start_;
+};
+
+#endif // BENCHMARK_COUNTERS_HPP
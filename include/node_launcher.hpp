@@ -0,0 +1,64 @@
+#ifndef NODE_LAUNCHER_HPP
+#define NODE_LAUNCHER_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/// A child process that runs a single node of a distributed benchmark.
+struct child_node {
+  pid_t pid;
+  /// Port the node listens on or 0 if the node failed to start.
+  uint16_t port;
+};
+
+/// Forks a child process that runs `fun(report)` and returns the port that
+/// the child passes to `report`. The child terminates with the return value
+/// of `fun`. Must run before the parent starts any threads, i.e., before
+/// constructing an actor system.
+template <class F>
+child_node fork_node(F fun) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    perror("pipe");
+    return {-1, 0};
+  }
+  auto pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    close(fds[0]);
+    close(fds[1]);
+    return {-1, 0};
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    auto report = [fd{fds[1]}](uint16_t port) {
+      if (write(fd, &port, sizeof(port)) != sizeof(port))
+        perror("write");
+      close(fd);
+    };
+    _exit(fun(report));
+  }
+  close(fds[1]);
+  uint16_t port = 0;
+  if (read(fds[0], &port, sizeof(port)) != sizeof(port))
+    port = 0;
+  close(fds[0]);
+  return {pid, port};
+}
+
+/// Blocks until `node` terminates and returns its exit status. Stores the
+/// resource usage of the child in `usage` unless it is `nullptr`.
+inline int wait_for(const child_node& node, rusage* usage = nullptr) {
+  int status = 0;
+  if (node.pid <= 0 || wait4(node.pid, &status, 0, usage) != node.pid)
+    return EXIT_FAILURE;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
+
+#endif // NODE_LAUNCHER_HPP
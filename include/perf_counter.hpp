@@ -0,0 +1,100 @@
+#ifndef PERF_COUNTER_HPP
+#define PERF_COUNTER_HPP
+
+#include <cstdint>
+
+#ifdef __linux__
+#  include <cstring>
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+/// Counts a hardware event of the calling thread via perf_event_open, e.g.,
+/// branch misses. The counter is invalid if the platform or the kernel
+/// (see /proc/sys/kernel/perf_event_paranoid) denies access to the event, in
+/// which case all member functions are no-ops and `value` returns 0.
+class perf_counter {
+public:
+#ifdef __linux__
+  static constexpr uint64_t branch_misses = PERF_COUNT_HW_BRANCH_MISSES;
+
+  static constexpr uint64_t cache_misses = PERF_COUNT_HW_CACHE_MISSES;
+
+  explicit perf_counter(uint64_t event = branch_misses) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = event;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  ~perf_counter() {
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+  bool valid() const noexcept {
+    return fd_ >= 0;
+  }
+
+  /// Resets the counter to 0 and starts counting.
+  void start() {
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  /// Stops counting without resetting the counter.
+  void stop() {
+    if (fd_ >= 0)
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+  }
+
+  uint64_t value() const {
+    uint64_t result = 0;
+    if (fd_ < 0 || read(fd_, &result, sizeof(result)) != sizeof(result))
+      return 0;
+    return result;
+  }
+
+private:
+  int fd_;
+#else
+  static constexpr uint64_t branch_misses = 0;
+
+  static constexpr uint64_t cache_misses = 0;
+
+  explicit perf_counter(uint64_t = branch_misses) {
+    // nop
+  }
+
+  bool valid() const noexcept {
+    return false;
+  }
+
+  void start() {
+    // nop
+  }
+
+  void stop() {
+    // nop
+  }
+
+  uint64_t value() const {
+    return 0;
+  }
+#endif
+
+  perf_counter(const perf_counter&) = delete;
+
+  perf_counter& operator=(const perf_counter&) = delete;
+};
+
+#endif // PERF_COUNTER_HPP
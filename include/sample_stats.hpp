@@ -0,0 +1,149 @@
+#ifndef SAMPLE_STATS_HPP
+#define SAMPLE_STATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+/// Collects samples (usually durations in nanoseconds) and computes summary
+/// statistics over them.
+class sample_set {
+public:
+  void reserve(size_t n) {
+    xs_.reserve(n);
+  }
+
+  void add(int64_t x) {
+    xs_.push_back(x);
+    sorted_ = false;
+  }
+
+  size_t size() const {
+    return xs_.size();
+  }
+
+  bool empty() const {
+    return xs_.empty();
+  }
+
+  void clear() {
+    xs_.clear();
+  }
+
+  /// Adds all samples of `other`.
+  void merge(const sample_set& other) {
+    if (other.xs_.empty())
+      return;
+    xs_.insert(xs_.end(), other.xs_.begin(), other.xs_.end());
+    sorted_ = false;
+  }
+
+  /// Returns the sample at percentile `p` in the range [0, 100].
+  int64_t percentile(double p) {
+    if (xs_.empty())
+      return 0;
+    if (!sorted_) {
+      std::sort(xs_.begin(), xs_.end());
+      sorted_ = true;
+    }
+    auto rank = static_cast<size_t>(p / 100.0 * (xs_.size() - 1) + 0.5);
+    return xs_[std::min(rank, xs_.size() - 1)];
+  }
+
+  double mean() const {
+    if (xs_.empty())
+      return 0;
+    double sum = 0;
+    for (auto x : xs_)
+      sum += static_cast<double>(x);
+    return sum / xs_.size();
+  }
+
+private:
+  std::vector<int64_t> xs_;
+  bool sorted_ = true;
+};
+
+/// A lock-free histogram with power-of-two buckets. Bucket 0 counts all
+/// samples <= 0 and bucket `i` counts all samples in [2^(i-1), 2^i).
+class log2_histogram {
+public:
+  static constexpr size_t num_buckets = 64;
+
+  using buckets = std::vector<uint64_t>;
+
+  log2_histogram() {
+    reset();
+  }
+
+  void add(int64_t x) {
+    buckets_[bucket_of(x)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void reset() {
+    for (auto& x : buckets_)
+      x.store(0, std::memory_order_relaxed);
+  }
+
+  buckets snapshot() const {
+    buckets result;
+    for (auto& x : buckets_)
+      result.push_back(x.load(std::memory_order_relaxed));
+    return result;
+  }
+
+  static size_t bucket_of(int64_t x) {
+    if (x <= 0)
+      return 0;
+    return 64 - static_cast<size_t>(__builtin_clzll(static_cast<uint64_t>(x)));
+  }
+
+  /// Returns the largest value that falls into bucket `i`.
+  static int64_t upper_bound(size_t i) {
+    if (i == 0)
+      return 0;
+    if (i >= 63)
+      return std::numeric_limits<int64_t>::max();
+    return (int64_t{1} << i) - 1;
+  }
+
+  /// Returns the upper bound of the bucket that contains percentile `p`.
+  static int64_t percentile(const buckets& xs, double p) {
+    uint64_t total = 0;
+    for (auto x : xs)
+      total += x;
+    if (total == 0)
+      return 0;
+    auto rank = static_cast<uint64_t>(p / 100.0 * (total - 1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < xs.size(); ++i) {
+      seen += xs[i];
+      if (seen > rank)
+        return upper_bound(i);
+    }
+    return upper_bound(xs.size() - 1);
+  }
+
+  /// Prints the number of samples, the p50 and p99 bounds and all non-empty
+  /// buckets of `xs` in a single line.
+  static void print(std::ostream& out, const char* label, const buckets& xs) {
+    uint64_t total = 0;
+    for (auto x : xs)
+      total += x;
+    out << label << ": n = " << total << ", p50 <= " << percentile(xs, 50)
+        << ", p99 <= " << percentile(xs, 99) << " |";
+    for (size_t i = 0; i < xs.size(); ++i)
+      if (xs[i] > 0)
+        out << " <=" << upper_bound(i) << ':' << xs[i];
+    out << '\n';
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, num_buckets> buckets_;
+};
+
+#endif // SAMPLE_STATS_HPP
@@ -0,0 +1,434 @@
+#ifndef TCP_RELAY_HPP
+#define TCP_RELAY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/// Configures how a `tcp_relay` shapes the traffic it forwards.
+struct shaping {
+  /// One-way delay added to each chunk.
+  std::chrono::microseconds delay{0};
+  /// Maximum deviation from `delay` (uniformly distributed). Chunks never
+  /// overtake each other, i.e., jitter never reorders the byte stream.
+  std::chrono::microseconds jitter{0};
+  /// Bandwidth cap per direction in bytes per second or 0 for no limit.
+  uint64_t rate = 0;
+  /// Splits the forwarded data into chunks of at most this many bytes (each
+  /// with its own delay) or 0 for forwarding whatever a single read returns.
+  size_t chunk_size = 0;
+};
+
+/// Parses a comma-separated list of `key=value` pairs with the keys `delay`
+/// and `jitter` (durations with unit `us`, `ms` or `s`), `rate` (with unit
+/// `kbit`, `mbit` or `gbit`) and `chunk` (bytes), e.g.,
+/// `delay=2ms,jitter=500us,rate=1gbit,chunk=1448`.
+inline bool parse_shaping(const std::string& spec, shaping& x) {
+  auto parse_num = [](const std::string& str, std::string& unit,
+                      double& num) {
+    char* end = nullptr;
+    num = strtod(str.c_str(), &end);
+    if (end == str.c_str() || num < 0)
+      return false;
+    unit = end;
+    return true;
+  };
+  size_t pos = 0;
+  while (pos < spec.size()) {
+    auto sep = spec.find(',', pos);
+    if (sep == std::string::npos)
+      sep = spec.size();
+    auto item = spec.substr(pos, sep - pos);
+    pos = sep + 1;
+    auto eq = item.find('=');
+    if (eq == std::string::npos)
+      return false;
+    auto key = item.substr(0, eq);
+    std::string unit;
+    double num = 0;
+    if (!parse_num(item.substr(eq + 1), unit, num))
+      return false;
+    if (key == "delay" || key == "jitter") {
+      double factor = 0;
+      if (unit == "us")
+        factor = 1;
+      else if (unit == "ms")
+        factor = 1e3;
+      else if (unit == "s")
+        factor = 1e6;
+      else
+        return false;
+      auto us = std::chrono::microseconds{static_cast<int64_t>(num * factor)};
+      (key == "delay" ? x.delay : x.jitter) = us;
+    } else if (key == "rate") {
+      double factor = 0;
+      if (unit == "kbit")
+        factor = 1e3;
+      else if (unit == "mbit")
+        factor = 1e6;
+      else if (unit == "gbit")
+        factor = 1e9;
+      else
+        return false;
+      x.rate = static_cast<uint64_t>(num * factor / 8);
+    } else if (key == "chunk" && unit.empty()) {
+      x.chunk_size = static_cast<size_t>(num);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Accepts TCP connections on a local port and forwards each of them to a
+/// fixed target while adding delay, jitter and a bandwidth cap per direction.
+/// Runs in userspace on its own thread, i.e., requires neither root nor `tc`.
+/// Note that the relay accepts connections locally, so the shaping applies to
+/// the payload only and not to the TCP handshake.
+class tcp_relay {
+public:
+  using clock = std::chrono::steady_clock;
+
+  /// Stop reading from a socket while more than this many bytes wait for
+  /// delivery in the opposite direction.
+  static constexpr size_t max_queued_bytes = 4 * 1024 * 1024;
+
+  tcp_relay(shaping cfg, std::string host, uint16_t port)
+    : cfg_(cfg), host_(std::move(host)), port_(port), rng_(port) {
+    // nop
+  }
+
+  tcp_relay(const tcp_relay&) = delete;
+
+  tcp_relay& operator=(const tcp_relay&) = delete;
+
+  ~tcp_relay() {
+    stop();
+  }
+
+  /// Starts listening on `listen_port` (0 picks a free port) and forwarding
+  /// connections on a background thread. Returns the actual port or 0 on
+  /// error.
+  uint16_t start(uint16_t listen_port = 0) {
+    // writing to a connection that the peer closed must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0)
+      return fail("socket");
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(listen_port);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+      return fail("bind");
+    if (listen(listen_fd_, SOMAXCONN) != 0)
+      return fail("listen");
+    socklen_t len = sizeof(addr);
+    if (getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0)
+      return fail("getsockname");
+    if (pipe(wakeup_) != 0)
+      return fail("pipe");
+    set_nonblocking(listen_fd_);
+    listen_port_ = ntohs(addr.sin_port);
+    thread_ = std::thread{[this] { run(); }};
+    return listen_port_;
+  }
+
+  /// Stops the background thread and closes all connections.
+  void stop() {
+    if (thread_.joinable()) {
+      char c = 0;
+      if (write(wakeup_[1], &c, 1) != 1)
+        perror("write");
+      thread_.join();
+    }
+    for (auto& conn : connections_) {
+      close(conn->fds[0]);
+      close(conn->fds[1]);
+    }
+    connections_.clear();
+    for (auto fd : {listen_fd_, wakeup_[0], wakeup_[1]})
+      if (fd >= 0)
+        close(fd);
+    listen_fd_ = wakeup_[0] = wakeup_[1] = -1;
+  }
+
+  /// Returns the local port of this relay.
+  uint16_t port() const {
+    return listen_port_;
+  }
+
+private:
+  struct chunk {
+    clock::time_point due;
+    std::vector<char> data;
+    size_t offset;
+  };
+
+  struct direction {
+    std::deque<chunk> queue;
+    size_t queued_bytes = 0;
+    clock::time_point link_free;
+    clock::time_point last_due;
+    bool eof = false;
+    bool done = false;
+  };
+
+  /// Forwards from fds[0] to fds[1] via dirs[0] and vice versa via dirs[1].
+  struct connection {
+    int fds[2];
+    direction dirs[2];
+    bool failed = false;
+  };
+
+  uint16_t fail(const char* what) {
+    perror(what);
+    stop();
+    return 0;
+  }
+
+  static void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  }
+
+  /// Opens a blocking connection to the target or returns -1.
+  int connect_upstream() {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addrs = nullptr;
+    auto port_str = std::to_string(port_);
+    if (getaddrinfo(host_.c_str(), port_str.c_str(), &hints, &addrs) != 0)
+      return -1;
+    int result = -1;
+    for (auto ai = addrs; ai != nullptr && result < 0; ai = ai->ai_next) {
+      auto fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd < 0)
+        continue;
+      if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        result = fd;
+      else
+        close(fd);
+    }
+    freeaddrinfo(addrs);
+    return result;
+  }
+
+  void accept_connection() {
+    auto fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0)
+      return;
+    auto upstream = connect_upstream();
+    if (upstream < 0) {
+      std::cerr << "tcp_relay: cannot connect to " << host_ << ":" << port_
+                << std::endl;
+      close(fd);
+      return;
+    }
+    int one = 1;
+    for (auto x : {fd, upstream}) {
+      set_nonblocking(x);
+      setsockopt(x, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    auto conn = std::make_unique<connection>();
+    conn->fds[0] = fd;
+    conn->fds[1] = upstream;
+    connections_.emplace_back(std::move(conn));
+  }
+
+  /// Computes when `size` bytes entering the link at `now` reach the peer.
+  clock::time_point schedule(direction& dir, clock::time_point now,
+                             size_t size) {
+    auto start = std::max(now, dir.link_free);
+    auto tx = std::chrono::nanoseconds{0};
+    if (cfg_.rate > 0)
+      tx = std::chrono::nanoseconds{size * 1000000000ull / cfg_.rate};
+    dir.link_free = start + tx;
+    auto delay = std::chrono::duration_cast<clock::duration>(cfg_.delay);
+    if (cfg_.jitter.count() > 0) {
+      std::uniform_int_distribution<int64_t> dist{-cfg_.jitter.count(),
+                                                  cfg_.jitter.count()};
+      auto us = std::max(int64_t{0}, cfg_.delay.count() + dist(rng_));
+      delay = std::chrono::microseconds{us};
+    }
+    auto due = std::max(dir.link_free + delay, dir.last_due);
+    dir.last_due = due;
+    return due;
+  }
+
+  /// Reads from `fd` into the queue of `dir`.
+  void read_from(connection& conn, int fd, direction& dir) {
+    char buf[65536];
+    auto n = read(fd, buf, sizeof(buf));
+    if (n == 0) {
+      dir.eof = true;
+      return;
+    }
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        conn.failed = true;
+      return;
+    }
+    auto now = clock::now();
+    auto size = static_cast<size_t>(n);
+    auto step = cfg_.chunk_size > 0 ? cfg_.chunk_size : size;
+    for (size_t pos = 0; pos < size; pos += step) {
+      auto len = std::min(step, size - pos);
+      chunk x{schedule(dir, now, len), {buf + pos, buf + pos + len}, 0};
+      dir.queue.emplace_back(std::move(x));
+      dir.queued_bytes += len;
+    }
+  }
+
+  /// Writes all due chunks of `dir` to `fd`.
+  void write_to(connection& conn, int fd, direction& dir) {
+    auto now = clock::now();
+    while (!dir.queue.empty() && dir.queue.front().due <= now) {
+      auto& x = dir.queue.front();
+      auto n = write(fd, x.data.data() + x.offset, x.data.size() - x.offset);
+      if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+          conn.failed = true;
+        return;
+      }
+      x.offset += static_cast<size_t>(n);
+      dir.queued_bytes -= static_cast<size_t>(n);
+      if (x.offset < x.data.size())
+        return;
+      dir.queue.pop_front();
+    }
+  }
+
+  void run() {
+    std::vector<pollfd> fds;
+    for (;;) {
+      // collect the events of interest per socket
+      auto now = clock::now();
+      auto next_due = clock::time_point::max();
+      std::map<int, short> events;
+      for (auto& conn : connections_) {
+        for (int i = 0; i < 2; ++i) {
+          auto& dir = conn->dirs[i];
+          auto from = conn->fds[i];
+          auto to = conn->fds[1 - i];
+          if (!dir.eof && dir.queued_bytes < max_queued_bytes)
+            events[from] |= POLLIN;
+          if (!dir.queue.empty()) {
+            if (dir.queue.front().due <= now)
+              events[to] |= POLLOUT;
+            else
+              next_due = std::min(next_due, dir.queue.front().due);
+          }
+        }
+      }
+      fds.clear();
+      fds.push_back({wakeup_[0], POLLIN, 0});
+      fds.push_back({listen_fd_, POLLIN, 0});
+      for (auto& kvp : events)
+        fds.push_back({kvp.first, kvp.second, 0});
+      timespec ts;
+      timespec* timeout = nullptr;
+      if (next_due != clock::time_point::max()) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(next_due
+                                                                       - now)
+                    .count();
+        ts.tv_sec = ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+        timeout = &ts;
+      }
+      if (ppoll(fds.data(), fds.size(), timeout, nullptr) < 0) {
+        if (errno == EINTR)
+          continue;
+        perror("ppoll");
+        return;
+      }
+      if (fds[0].revents != 0)
+        return;
+      if (fds[1].revents & POLLIN)
+        accept_connection();
+      std::map<int, short> revents;
+      for (size_t i = 2; i < fds.size(); ++i)
+        revents[fds[i].fd] = fds[i].revents;
+      // forward data and retire finished connections
+      for (auto& conn : connections_) {
+        for (int i = 0; i < 2 && !conn->failed; ++i) {
+          auto& dir = conn->dirs[i];
+          auto from = conn->fds[i];
+          auto to = conn->fds[1 - i];
+          if (revents[from] & (POLLIN | POLLHUP | POLLERR))
+            read_from(*conn, from, dir);
+          if (revents[to] & (POLLOUT | POLLERR))
+            write_to(*conn, to, dir);
+          if (dir.eof && dir.queue.empty() && !dir.done) {
+            shutdown(to, SHUT_WR);
+            dir.done = true;
+          }
+        }
+      }
+      auto finished = [](const std::unique_ptr<connection>& conn) {
+        if (!conn->failed && !(conn->dirs[0].done && conn->dirs[1].done))
+          return false;
+        close(conn->fds[0]);
+        close(conn->fds[1]);
+        return true;
+      };
+      connections_.erase(std::remove_if(connections_.begin(),
+                                        connections_.end(), finished),
+                         connections_.end());
+    }
+  }
+
+  shaping cfg_;
+  std::string host_;
+  uint16_t port_;
+  uint16_t listen_port_ = 0;
+  int listen_fd_ = -1;
+  int wakeup_[2] = {-1, -1};
+  std::minstd_rand rng_;
+  std::thread thread_;
+  std::vector<std::unique_ptr<connection>> connections_;
+};
+
+/// Owns one relay per target.
+class tcp_relay_set {
+public:
+  explicit tcp_relay_set(shaping cfg) : cfg_(cfg) {
+    // nop
+  }
+
+  /// Starts a relay to `host:port` and returns its local port or 0 on error.
+  uint16_t add(const std::string& host, uint16_t port) {
+    relays_.emplace_back(std::make_unique<tcp_relay>(cfg_, host, port));
+    return relays_.back()->start();
+  }
+
+private:
+  shaping cfg_;
+  std::vector<std::unique_ptr<tcp_relay>> relays_;
+};
+
+#endif // TCP_RELAY_HPP
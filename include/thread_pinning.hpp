@@ -0,0 +1,221 @@
+#ifndef THREAD_PINNING_HPP
+#define THREAD_PINNING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#ifdef __linux__
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+
+#include "caf/actor_system_config.hpp"
+#include "caf/thread_hook.hpp"
+
+// Newer CAF versions pass the owner of a thread to the thread hook.
+#if __has_include("caf/thread_owner.hpp")
+#  include "caf/thread_owner.hpp"
+#  define CAF_BENCH_HAS_THREAD_OWNER
+#endif
+
+#include "bench_args.hpp"
+
+/// Selects how scheduler workers map to CPUs.
+enum class pinning_policy {
+  /// Leave placement to the OS.
+  none,
+  /// Fill one core (including its hyperthreads) and socket after another.
+  compact,
+  /// Distribute workers round-robin over all sockets.
+  scatter,
+  /// Use only one hardware thread per physical core.
+  physical,
+};
+
+inline bool from_string(const std::string& str, pinning_policy& x) {
+  if (str == "none")
+    x = pinning_policy::none;
+  else if (str == "compact")
+    x = pinning_policy::compact;
+  else if (str == "scatter")
+    x = pinning_policy::scatter;
+  else if (str == "physical")
+    x = pinning_policy::physical;
+  else
+    return false;
+  return true;
+}
+
+/// Location of a logical CPU in the machine topology.
+struct cpu_info {
+  int id;
+  int package;
+  int core;
+};
+
+inline int read_topology_value(int cpu, const char* name, int fallback) {
+  std::ostringstream path;
+  path << "/sys/devices/system/cpu/cpu" << cpu << "/topology/" << name;
+  std::ifstream in{path.str()};
+  int result;
+  if (in >> result)
+    return result;
+  return fallback;
+}
+
+/// Returns all CPUs this process may run on along with their socket and core.
+inline std::vector<cpu_info> read_topology() {
+  std::vector<cpu_info> result;
+#ifdef __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return result;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    if (CPU_ISSET(cpu, &allowed))
+      result.push_back(cpu_info{
+        cpu, read_topology_value(cpu, "physical_package_id", 0),
+        read_topology_value(cpu, "core_id", cpu)});
+#endif
+  return result;
+}
+
+/// Orders `cpus` in the sequence workers get assigned to them.
+inline std::vector<int> cpu_order(pinning_policy policy,
+                                  std::vector<cpu_info> cpus) {
+  auto key = [](const cpu_info& x) {
+    return std::make_tuple(x.package, x.core, x.id);
+  };
+  std::sort(cpus.begin(), cpus.end(),
+            [&](const cpu_info& x, const cpu_info& y) { return key(x) < key(y); });
+  std::vector<int> result;
+  switch (policy) {
+    case pinning_policy::none:
+      break;
+    case pinning_policy::compact:
+      for (auto& x : cpus)
+        result.push_back(x.id);
+      break;
+    case pinning_policy::scatter: {
+      // One sorted CPU list per socket, then take one CPU from each in turn.
+      std::map<int, std::vector<int>> sockets;
+      for (auto& x : cpus)
+        sockets[x.package].push_back(x.id);
+      for (size_t i = 0; result.size() < cpus.size(); ++i)
+        for (auto& kvp : sockets)
+          if (i < kvp.second.size())
+            result.push_back(kvp.second[i]);
+      break;
+    }
+    case pinning_policy::physical: {
+      // First hardware thread of each core, hyperthreads only as fallback.
+      std::vector<int> siblings;
+      for (size_t i = 0; i < cpus.size(); ++i)
+        if (i > 0 && cpus[i].package == cpus[i - 1].package
+            && cpus[i].core == cpus[i - 1].core)
+          siblings.push_back(cpus[i].id);
+        else
+          result.push_back(cpus[i].id);
+      result.insert(result.end(), siblings.begin(), siblings.end());
+      break;
+    }
+  }
+  return result;
+}
+
+/// Pins each scheduler worker of an actor system to a single CPU. Other
+/// threads (detached actors, middleman, clock, etc.) remain unpinned.
+class pinning_hook : public caf::thread_hook {
+public:
+  explicit pinning_hook(pinning_policy policy) : policy_(policy), next_(0) {
+    // nop
+  }
+
+  void init(caf::actor_system&) override {
+#ifdef __linux__
+    cpus_ = cpu_order(policy_, read_topology());
+#else
+    if (policy_ != pinning_policy::none)
+      std::cerr << "thread pinning is only supported on Linux" << std::endl;
+#endif
+  }
+
+#ifdef CAF_BENCH_HAS_THREAD_OWNER
+  void thread_started(caf::thread_owner owner) override {
+    if (owner == caf::thread_owner::scheduler)
+      pin_this_thread();
+  }
+#else
+  void thread_started() override {
+    // CAF names threads before calling the hook.
+    char name[16] = {};
+#  ifdef __linux__
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+#  endif
+    if (strncmp(name, "caf.worker", 10) == 0)
+      pin_this_thread();
+  }
+#endif
+
+  void thread_terminates() override {
+    // nop
+  }
+
+private:
+  /// Pins the calling thread to the next CPU in the order of the policy.
+  void pin_this_thread() {
+#ifdef __linux__
+    if (cpus_.empty())
+      return;
+    auto index = next_++;
+    auto cpu = cpus_[index % cpus_.size()];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    std::ostringstream log;
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+      log << "pinned worker " << index << " to CPU " << cpu << '\n';
+    else
+      log << "failed to pin worker " << index << " to CPU " << cpu << '\n';
+    std::cerr << log.str();
+#endif
+  }
+
+  pinning_policy policy_;
+  std::vector<int> cpus_;
+  std::atomic<size_t> next_;
+};
+
+/// Registers a `pinning_hook` at `cfg` unless `policy` is `none`.
+inline void add_pinning_hook(caf::actor_system_config& cfg,
+                             pinning_policy policy) {
+  if (policy != pinning_policy::none)
+    cfg.add_thread_hook<pinning_hook>(policy);
+}
+
+/// Removes `--pin=POLICY` from the command line and stores the policy in `x`.
+/// Returns `false` if the argument names an unknown policy.
+inline bool take_pinning_policy(int& argc, char** argv, pinning_policy& x) {
+  x = pinning_policy::none;
+  if (auto str = take_arg(argc, argv, "pin")) {
+    if (!from_string(*str, x)) {
+      std::cerr << "unknown pinning policy: " << *str << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Usage text for the `--pin` option.
+constexpr const char* pinning_usage
+  = "  --pin=POLICY  pin scheduler workers (none|compact|scatter|physical)\n";
+
+#endif // THREAD_PINNING_HPP
@@ -24,6 +24,8 @@
 
 #include "caf/all.hpp"
 
+#include "thread_pinning.hpp"
+
 #if CAF_VERSION < 1800
 
 using spread_atom = caf::atom_constant<caf::atom("spread")>;
@@ -89,13 +91,15 @@ behavior testee(event_based_actor* self, actor parent) {
 }
 
 void usage() {
-  std::cout << "usage: actor_creation POW\n"
-               "       creates 2^POW actors\n\n";
+  std::cout << "usage: actor_creation [--pin=POLICY] POW\n"
+               "       creates 2^POW actors\n\n"
+            << pinning_usage << '\n';
   exit(1);
 }
 
 int main(int argc, char** argv) {
-  if (argc != 2)
+  pinning_policy pin;
+  if (!take_pinning_policy(argc, argv, pin) || argc != 2)
     usage();
 #if CAF_VERSION >= 1800
   init_global_meta_objects<caf::id_block::actor_creation>();
@@ -103,6 +107,7 @@ int main(int argc, char** argv) {
 #endif
   s_num = static_cast<uint32_t>(std::stoi(argv[1]));
   actor_system_config cfg;
+  add_pinning_hook(cfg, pin);
   actor_system system{cfg};
   scoped_actor self{system};
   anon_send(system.spawn<lazy_init>(testee, self), spread_atom_v, s_num);
@@ -0,0 +1,511 @@
+/******************************************************************************
+ *                       ____    _    _____                                   *
+ *                      / ___|  / \  |  ___|    C++                           *
+ *                     | |     / _ \ | |_       Actor                         *
+ *                     | |___ / ___ \|  _|      Framework                     *
+ *                      \____/_/   \_|_|                                      *
+ *                                                                            *
+ * Copyright (C) 2011 - 2017                                                  *
+ * Dominik Charousset <dominik.charousset (at) haw-hamburg.de>                *
+ *                                                                            *
+ * Distributed under the terms and conditions of the BSD 3-Clause License or  *
+ * (at your option) under the terms and conditions of the Boost Software      *
+ * License 1.0. See accompanying files LICENSE and LICENSE_ALTERNATIVE.       *
+ *                                                                            *
+ * If you did not receive a copy of the license files, see                    *
+ * http://opensource.org/licenses/BSD-3-Clause and                            *
+ * http://www.boost.org/LICENSE_1_0.txt.                                      *
+ ******************************************************************************/
+
+// Measures the overhead of CAF brokers for raw TCP protocols. For each
+// combination of server, connection count and message size, the program forks
+// an echo server and drives it with a load generator that keeps one message
+// in flight per connection. Servers:
+// - caf: an io::broker that reads fixed-size messages and writes them back
+// - epoll: a minimal single-threaded epoll server that echoes all bytes
+// The load generator is a single-threaded epoll client in the parent process
+// and stays the same for both servers. Each row reports the echo throughput,
+// round-trip percentiles and the CPU time of the server process per echoed
+// byte (from wait4 after shutting the server down with SIGTERM).
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "caf/all.hpp"
+#include "caf/io/all.hpp"
+
+#include "node_launcher.hpp"
+#include "sample_stats.hpp"
+#include "thread_pinning.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+using namespace caf;
+
+using hrc = std::chrono::high_resolution_clock;
+
+namespace {
+
+struct params {
+  string servers = "caf,epoll";
+  vector<size_t> connections{1, 10, 100, 1000, 10000};
+  vector<size_t> sizes{64, 1024, 16384};
+  std::chrono::milliseconds duration{2000};
+};
+
+int usage() {
+  cout << "usage: broker_echo [OPTION]..." << endl
+       << endl
+       << "  --servers=LIST      comma-separated list of servers (caf,epoll)"
+       << endl
+       << "  --connections=LIST  comma-separated list of connection counts"
+       << endl
+       << "                      (default: 1,10,100,1000,10000)" << endl
+       << "  --sizes=LIST        comma-separated list of message sizes in"
+       << endl
+       << "                      bytes (default: 64,1024,16384)" << endl
+       << "  --duration=MS       measurement time per row (default: 2000)"
+       << endl
+       << pinning_usage << endl;
+  return EXIT_FAILURE;
+}
+
+bool parse_list(const string& str, vector<size_t>& xs) {
+  xs.clear();
+  std::istringstream in{str};
+  for (string item; std::getline(in, item, ',');) {
+    auto x = strtoull(item.c_str(), nullptr, 10);
+    if (x == 0)
+      return false;
+    xs.emplace_back(static_cast<size_t>(x));
+  }
+  return !xs.empty();
+}
+
+/// Raises the soft limit for open files to the hard limit, since each
+/// connection takes one descriptor in the client and one in the server.
+void raise_fd_limit(size_t required) {
+  rlimit lim;
+  if (getrlimit(RLIMIT_NOFILE, &lim) != 0)
+    return;
+  lim.rlim_cur = lim.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &lim);
+  if (lim.rlim_cur < required)
+    cerr << "warning: RLIMIT_NOFILE is " << lim.rlim_cur << " but up to "
+         << required << " connections require more descriptors" << endl;
+}
+
+void set_nonblocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+void set_nodelay(int fd) {
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+/// Blocks SIGTERM for the calling thread and all threads it starts later.
+sigset_t block_sigterm() {
+  sigset_t sigs;
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
+  return sigs;
+}
+
+// -- CAF server ---------------------------------------------------------------
+
+struct config : actor_system_config {
+  config(pinning_policy pin) {
+    load<io::middleman>();
+    add_pinning_hook(*this, pin);
+  }
+};
+
+behavior echo_broker(io::broker* self, uint32_t size) {
+  return {
+    [=](const io::new_connection_msg& msg) {
+      self->configure_read(msg.handle, io::receive_policy::exactly(size));
+    },
+    [=](const io::new_data_msg& msg) {
+      auto& buf = self->wr_buf(msg.handle);
+      buf.insert(buf.end(), msg.buf.begin(), msg.buf.end());
+      self->flush(msg.handle);
+    },
+    [=](const io::connection_closed_msg&) {
+      // nop
+    },
+  };
+}
+
+template <class F>
+int run_caf_server(pinning_policy pin, size_t size, F report) {
+  auto sigs = block_sigterm();
+  config cfg{pin};
+  actor_system sys{cfg};
+  uint16_t port = 0;
+  auto server = sys.middleman().spawn_server(echo_broker, port,
+                                             static_cast<uint32_t>(size));
+  if (!server) {
+    cerr << "cannot spawn broker: " << to_string(server.error()) << endl;
+    return EXIT_FAILURE;
+  }
+  report(port);
+  int sig = 0;
+  sigwait(&sigs, &sig);
+  anon_send_exit(*server, exit_reason::user_shutdown);
+  return EXIT_SUCCESS;
+}
+
+// -- epoll server -------------------------------------------------------------
+
+/// Bytes that an epoll connection still needs to write.
+struct pending_output {
+  vector<char> buf;
+  size_t offset = 0;
+};
+
+template <class F>
+int run_epoll_server(F report) {
+  auto sigs = block_sigterm();
+  auto sig_fd = signalfd(-1, &sigs, 0);
+  auto listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), len) != 0
+      || listen(listen_fd, SOMAXCONN) != 0
+      || getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len)
+           != 0) {
+    perror("epoll server");
+    return EXIT_FAILURE;
+  }
+  set_nonblocking(listen_fd);
+  auto ep = epoll_create1(0);
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = listen_fd;
+  epoll_ctl(ep, EPOLL_CTL_ADD, listen_fd, &ev);
+  ev.data.fd = sig_fd;
+  epoll_ctl(ep, EPOLL_CTL_ADD, sig_fd, &ev);
+  report(ntohs(addr.sin_port));
+  // indexed by file descriptor
+  vector<pending_output> pending;
+  vector<epoll_event> events(1024);
+  char buf[65536];
+  auto close_conn = [&](int fd) {
+    epoll_ctl(ep, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    pending[fd].buf.clear();
+    pending[fd].offset = 0;
+  };
+  // writes pending output and returns false on error
+  auto flush = [&](int fd) {
+    auto& out = pending[fd];
+    while (out.offset < out.buf.size()) {
+      auto n = write(fd, out.buf.data() + out.offset,
+                     out.buf.size() - out.offset);
+      if (n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+      out.offset += static_cast<size_t>(n);
+    }
+    out.buf.clear();
+    out.offset = 0;
+    return true;
+  };
+  for (;;) {
+    auto n = epoll_wait(ep, events.data(), static_cast<int>(events.size()), -1);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      return EXIT_FAILURE;
+    }
+    for (int i = 0; i < n; ++i) {
+      auto fd = events[i].data.fd;
+      if (fd == sig_fd)
+        return EXIT_SUCCESS;
+      if (fd == listen_fd) {
+        for (auto conn = accept(listen_fd, nullptr, nullptr); conn >= 0;
+             conn = accept(listen_fd, nullptr, nullptr)) {
+          set_nonblocking(conn);
+          set_nodelay(conn);
+          if (static_cast<size_t>(conn) >= pending.size())
+            pending.resize(conn + 1);
+          epoll_event conn_ev;
+          conn_ev.events = EPOLLIN;
+          conn_ev.data.fd = conn;
+          epoll_ctl(ep, EPOLL_CTL_ADD, conn, &conn_ev);
+        }
+        continue;
+      }
+      auto& out = pending[fd];
+      if (events[i].events & EPOLLIN) {
+        auto rd = read(fd, buf, sizeof(buf));
+        if (rd == 0 || (rd < 0 && errno != EAGAIN)) {
+          close_conn(fd);
+          continue;
+        }
+        if (rd > 0)
+          out.buf.insert(out.buf.end(), buf, buf + rd);
+      }
+      auto had_output = !out.buf.empty();
+      if (!flush(fd)) {
+        close_conn(fd);
+        continue;
+      }
+      // only wait for EPOLLOUT while output remains
+      if (had_output) {
+        epoll_event conn_ev;
+        conn_ev.events = out.buf.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+        conn_ev.data.fd = fd;
+        epoll_ctl(ep, EPOLL_CTL_MOD, fd, &conn_ev);
+      }
+    }
+  }
+}
+
+// -- load generator -----------------------------------------------------------
+
+struct client_conn {
+  int fd = -1;
+  hrc::time_point sent_at;
+  size_t written = 0;
+  size_t received = 0;
+};
+
+struct load_result {
+  uint64_t messages = 0;
+  double seconds = 0;
+  sample_set rtt;
+};
+
+/// Opens `num` connections to `port` and keeps one message of `size` bytes in
+/// flight on each of them for `duration`.
+bool run_load(uint16_t port, size_t num, size_t size,
+              std::chrono::milliseconds duration, load_result& result) {
+  vector<client_conn> conns(num);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  auto ep = epoll_create1(0);
+  auto cleanup = [&] {
+    for (auto& conn : conns)
+      if (conn.fd >= 0)
+        close(conn.fd);
+    close(ep);
+  };
+  for (size_t i = 0; i < num; ++i) {
+    auto fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))
+                    != 0) {
+      perror("connect");
+      if (fd >= 0)
+        close(fd);
+      cleanup();
+      return false;
+    }
+    set_nonblocking(fd);
+    set_nodelay(fd);
+    conns[i].fd = fd;
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = i;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+  }
+  vector<char> msg(size, 'x');
+  vector<char> buf(std::max(size, size_t{65536}));
+  // writes the remainder of the current message, returns false on error
+  auto send_msg = [&](size_t i) {
+    auto& conn = conns[i];
+    while (conn.written < size) {
+      auto n = write(conn.fd, msg.data() + conn.written, size - conn.written);
+      if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+          return false;
+        epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.u64 = i;
+        epoll_ctl(ep, EPOLL_CTL_MOD, conn.fd, &ev);
+        return true;
+      }
+      conn.written += static_cast<size_t>(n);
+    }
+    return true;
+  };
+  auto start = hrc::now();
+  auto deadline = start + duration;
+  for (size_t i = 0; i < num; ++i) {
+    conns[i].sent_at = start;
+    if (!send_msg(i)) {
+      cleanup();
+      return false;
+    }
+  }
+  vector<epoll_event> events(1024);
+  auto ok = true;
+  auto now = start;
+  while (ok && now < deadline) {
+    auto n = epoll_wait(ep, events.data(), static_cast<int>(events.size()),
+                        10);
+    now = hrc::now();
+    for (int j = 0; j < n && ok; ++j) {
+      auto i = static_cast<size_t>(events[j].data.u64);
+      auto& conn = conns[i];
+      if (events[j].events & EPOLLOUT) {
+        auto was_pending = conn.written < size;
+        ok = send_msg(i);
+        if (was_pending && conn.written == size) {
+          epoll_event ev;
+          ev.events = EPOLLIN;
+          ev.data.u64 = i;
+          epoll_ctl(ep, EPOLL_CTL_MOD, conn.fd, &ev);
+        }
+      }
+      if (!(events[j].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+        continue;
+      auto rd = read(conn.fd, buf.data(), size - conn.received);
+      if (rd <= 0) {
+        if (rd == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+          cerr << "server closed connection" << endl;
+          ok = false;
+        }
+        continue;
+      }
+      conn.received += static_cast<size_t>(rd);
+      if (conn.received < size)
+        continue;
+      // full echo received: record round trip and send the next message
+      now = hrc::now();
+      result.rtt.add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now
+                                                             - conn.sent_at)
+          .count());
+      ++result.messages;
+      conn.sent_at = now;
+      conn.written = 0;
+      conn.received = 0;
+      ok = send_msg(i);
+    }
+  }
+  result.seconds = std::chrono::duration<double>(now - start).count();
+  cleanup();
+  return ok;
+}
+
+// -- benchmark driver ---------------------------------------------------------
+
+void print_header() {
+  cout << std::left << std::setw(8) << "server" << std::right
+       << std::setw(8) << "conns" << std::setw(8) << "bytes" << std::setw(12)
+       << "msgs/s" << std::setw(10) << "MB/s" << std::setw(11) << "p50_us"
+       << std::setw(11) << "p99_us" << std::setw(13) << "cpu_ns/byte"
+       << std::setw(10) << "cpu_%" << endl;
+}
+
+bool run_row(pinning_policy pin, const string& server, size_t num,
+             size_t size, std::chrono::milliseconds duration) {
+  auto child = fork_node([&](auto report) {
+    if (server == "caf")
+      return run_caf_server(pin, size, report);
+    return run_epoll_server(report);
+  });
+  if (child.port == 0) {
+    cerr << "failed to launch " << server << " server" << endl;
+    wait_for(child);
+    return false;
+  }
+  load_result res;
+  auto ok = run_load(child.port, num, size, duration, res);
+  kill(child.pid, SIGTERM);
+  rusage usage;
+  memset(&usage, 0, sizeof(usage));
+  wait_for(child, &usage);
+  if (!ok)
+    return false;
+  auto to_ns = [](const timeval& tv) {
+    return static_cast<double>(tv.tv_sec) * 1e9 + tv.tv_usec * 1e3;
+  };
+  auto cpu_ns = to_ns(usage.ru_utime) + to_ns(usage.ru_stime);
+  auto bytes = static_cast<double>(res.messages * size);
+  auto to_us = [](int64_t ns) { return ns / 1000.0; };
+  cout << std::left << std::setw(8) << server << std::right << std::setw(8)
+       << num << std::setw(8) << size << std::fixed << std::setprecision(1)
+       << std::setw(12) << res.messages / res.seconds << std::setw(10)
+       << bytes / res.seconds / 1e6 << std::setprecision(2) << std::setw(11)
+       << to_us(res.rtt.percentile(50)) << std::setw(11)
+       << to_us(res.rtt.percentile(99)) << std::setw(13)
+       << (bytes > 0 ? cpu_ns / bytes : 0.0) << std::setprecision(1)
+       << std::setw(10) << 100.0 * cpu_ns / (res.seconds * 1e9) << endl;
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+#if CAF_VERSION >= 1800
+  io::middleman::init_global_meta_objects();
+  core::init_global_meta_objects();
+#endif
+  pinning_policy pin;
+  if (!take_pinning_policy(argc, argv, pin))
+    return usage();
+  params ps;
+  if (auto str = take_arg(argc, argv, "servers"))
+    ps.servers = *str;
+  if (auto str = take_arg(argc, argv, "connections"))
+    if (!parse_list(*str, ps.connections))
+      return usage();
+  if (auto str = take_arg(argc, argv, "sizes"))
+    if (!parse_list(*str, ps.sizes))
+      return usage();
+  if (auto str = take_arg(argc, argv, "duration"))
+    ps.duration = std::chrono::milliseconds{atoi(str->c_str())};
+  if (argc != 1 || ps.duration.count() <= 0)
+    return usage();
+  vector<string> servers;
+  std::istringstream servers_str{ps.servers};
+  for (string server; std::getline(servers_str, server, ',');) {
+    if (server != "caf" && server != "epoll")
+      return usage();
+    servers.emplace_back(std::move(server));
+  }
+  raise_fd_limit(*std::max_element(ps.connections.begin(),
+                                   ps.connections.end())
+                 + 64);
+  // writing to a connection that the server closed must not kill the client
+  signal(SIGPIPE, SIG_IGN);
+  print_header();
+  for (auto num : ps.connections)
+    for (auto size : ps.sizes)
+      for (auto& server : servers)
+        if (!run_row(pin, server, num, size, ps.duration))
+          return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
@@ -17,347 +17,711 @@
  * http://www.boost.org/LICENSE_1_0.txt.                                      *
  ******************************************************************************/
 
+#include <algorithm>
 #include <chrono>
-#include <utility>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <netdb.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include "caf/all.hpp"
 #include "caf/io/all.hpp"
 
-using namespace std;
+#include "node_launcher.hpp"
+#include "sample_stats.hpp"
+#include "tcp_relay.hpp"
+#include "thread_pinning.hpp"
+
+/// Resource usage and connection setup times of a single server node.
+struct node_stats {
+  /// User plus system CPU time of the node in microseconds.
+  int64_t cpu_us = 0;
+  /// Resident set size of the node in bytes.
+  int64_t rss_bytes = 0;
+  /// Time for connecting to each peer, i.e., TCP connect plus BASP handshake.
+  std::vector<int64_t> connect_ns;
+};
+
+#if CAF_VERSION < 1800
+
+using ping_atom = caf::atom_constant<caf::atom("ping")>;
+using pong_atom = caf::atom_constant<caf::atom("pong")>;
+using kickoff_atom = caf::atom_constant<caf::atom("kickoff")>;
+using done_atom = caf::atom_constant<caf::atom("done")>;
+using purge_atom = caf::atom_constant<caf::atom("purge")>;
+using stats_atom = caf::atom_constant<caf::atom("stats")>;
+static constexpr ping_atom ping_atom_v = ping_atom::value;
+static constexpr pong_atom pong_atom_v = pong_atom::value;
+static constexpr kickoff_atom kickoff_atom_v = kickoff_atom::value;
+static constexpr done_atom done_atom_v = done_atom::value;
+static constexpr purge_atom purge_atom_v = purge_atom::value;
+static constexpr stats_atom stats_atom_v = stats_atom::value;
+
+template <class Inspector>
+typename Inspector::result_type inspect(Inspector& f, node_stats& x) {
+  return f(caf::meta::type_name("node_stats"), x.cpu_us, x.rss_bytes,
+           x.connect_ns);
+}
+
+#else
+
+CAF_BEGIN_TYPE_ID_BLOCK(distributed, first_custom_type_id)
+
+  CAF_ADD_ATOM(distributed, kickoff_atom);
+  CAF_ADD_ATOM(distributed, done_atom);
+  CAF_ADD_ATOM(distributed, purge_atom);
+  CAF_ADD_ATOM(distributed, stats_atom);
+
+  CAF_ADD_TYPE_ID(distributed, (node_stats) );
+
+CAF_END_TYPE_ID_BLOCK(distributed)
+
+template <class Inspector>
+bool inspect(Inspector& f, node_stats& x) {
+  return f.object(x).fields(f.field("cpu_us", x.cpu_us),
+                            f.field("rss_bytes", x.rss_bytes),
+                            f.field("connect_ns", x.connect_ns));
+}
+
+#endif
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
 using namespace caf;
 
 namespace {
 
-void usage() {
-    cout << "Running in server mode:"                                    << endl
-         << "  mode=server  "                                            << endl
-         << "  --port=NUM       publishes an actor at port NUM"          << endl
-         << "  -p NUM           alias for --port=NUM"                    << endl
-         << endl
-         << endl
-         << "Running the benchmark:"                                     << endl
-         << "  mode=benchmark run the benchmark, connect to any number"  << endl
-         << "                 of given servers, use HOST:PORT syntax"    << endl
-         << "  num_pings=NUM  run benchmark with NUM messages per node"  << endl
-         << endl
-         << "  example: mode=benchmark 192.168.9.1:1234 "
-                                        "192.168.9.2:1234 "
-                                        "--num_pings=100"                << endl
-         << endl
-         << endl
-         << "Shutdown servers:"                                          << endl
-         << "  mode=shutdown  shuts down any number of given servers"    << endl
-         << endl
-         << endl
-         << "Miscellaneous:"                                             << endl
-         << "  -h, --help       print this text and exit"                << endl
-         << endl;
-    exit(0);
+struct endpoint {
+  string host;
+  uint16_t port;
+};
+
+int usage() {
+  cout << "Running in server mode:" << endl
+       << "  mode=server" << endl
+       << "  --port=NUM       publishes an actor at port NUM" << endl
+       << "  -p NUM           alias for --port=NUM" << endl
+       << endl
+       << endl
+       << "Running the benchmark:" << endl
+       << "  mode=benchmark   run the benchmark, connect to any number" << endl
+       << "                   of given servers, use HOST:PORT syntax" << endl
+       << "  --num_pings=NUM  run benchmark with NUM messages per node" << endl
+       << endl
+       << "  example: mode=benchmark 192.168.9.1:1234 "
+          "192.168.9.2:1234 "
+          "--num_pings=100"
+       << endl
+       << endl
+       << endl
+       << "Running the benchmark on a single machine:" << endl
+       << "  mode=launch      start server processes on loopback, run the"
+       << endl
+       << "                   benchmark and shut down all servers" << endl
+       << "  --nodes=NUM      number of server processes, 2-64 (default: 2)"
+       << endl
+       << "  --num_pings=NUM  run benchmark with NUM messages per node" << endl
+       << "  --shape=SPEC     route all connections through relays that add"
+       << endl
+       << "                   delay, jitter and bandwidth caps, e.g.," << endl
+       << "                   delay=250us,jitter=50us,rate=10gbit,chunk=1448"
+       << endl
+       << "                   (see also: tcp_relay)" << endl
+       << endl
+       << endl
+       << "Options for mode=benchmark and mode=launch:" << endl
+       << "  --setup=MODE     connect all nodes at once (parallel, default)"
+       << endl
+       << "                   or one pair after another (sequential)" << endl
+       << endl
+       << endl
+       << "Shutdown servers:" << endl
+       << "  mode=shutdown    shuts down any number of given servers" << endl
+       << endl
+       << endl
+       << "Miscellaneous:" << endl
+       << "  -h, --help       print this text and exit" << endl
+       << pinning_usage << endl;
+  return EXIT_FAILURE;
+}
+
+template <class... Ts>
+int usage(const Ts&... xs) {
+  (cout << ... << xs) << endl << endl;
+  return usage();
+}
+
+// -- resource usage -----------------------------------------------------------
+
+int64_t to_ns(std::chrono::steady_clock::duration x) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(x).count();
+}
+
+int64_t cpu_time_us() {
+  rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return 0;
+  auto us = [](const timeval& tv) {
+    return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+  };
+  return us(ru.ru_utime) + us(ru.ru_stime);
+}
+
+int64_t rss_bytes() {
+  // the second field of statm is the number of resident pages
+  std::ifstream in{"/proc/self/statm"};
+  int64_t size = 0;
+  int64_t resident = 0;
+  if (!(in >> size >> resident))
+    return 0;
+  return resident * sysconf(_SC_PAGESIZE);
 }
 
-class ping_actor : public event_based_actor {
+/// Returns how long a plain TCP connect to `host:port` takes or -1 on error.
+/// Serves as baseline for separating the BASP handshake from the connect.
+int64_t tcp_connect_ns(const string& host, uint16_t port) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addrs = nullptr;
+  auto port_str = std::to_string(port);
+  if (getaddrinfo(host.c_str(), port_str.c_str(), &hints, &addrs) != 0)
+    return -1;
+  int64_t result = -1;
+  for (auto ai = addrs; ai != nullptr && result < 0; ai = ai->ai_next) {
+    auto fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0)
+      continue;
+    auto t0 = std::chrono::steady_clock::now();
+    if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+      result = to_ns(std::chrono::steady_clock::now() - t0);
+    ::close(fd);
+  }
+  freeaddrinfo(addrs);
+  return result;
+}
+
+// -- actors -------------------------------------------------------------------
+
+behavior ping_actor(event_based_actor* self, actor parent) {
+  return {
+    [=](kickoff_atom, const actor& pong, uint32_t value) {
+      self->send(pong, ping_atom_v, value);
+      self->become([=](pong_atom, uint32_t x) {
+        if (x == 0) {
+          self->send(parent, done_atom_v);
+          self->quit();
+          return;
+        }
+        self->send(pong, ping_atom_v, x - 1);
+      });
+    },
+  };
+}
+
+class server_actor : public event_based_actor {
 public:
-  ping_actor(actor_config& cfg, actor parent)
-      : event_based_actor(cfg),
-        parent_(move(parent)) {
-    // nop
+  using pong_map = std::map<std::pair<string, uint16_t>, actor>;
+
+  server_actor(actor_config& cfg) : event_based_actor(cfg) {
+    set_down_handler([=](down_msg& dm) {
+      auto i = std::find_if(pongs_.begin(), pongs_.end(),
+                            [&](const pong_map::value_type& kvp) {
+                              return kvp.second.address() == dm.source;
+                            });
+      if (i != pongs_.end())
+        pongs_.erase(i);
+    });
   }
 
   behavior make_behavior() override {
     return {
-      on(atom("kickoff"), arg_match) >> [=](actor pong, uint32_t value) {
-        send(pong, atom("ping"), value);
-        become (
-          on(atom("pong"), uint32_t(0)) >> [=] {
-            send(parent_, atom("done"));
-            quit();
-          },
-          on(atom("pong"), arg_match) >> [=](uint32_t x) {
-            return make_tuple(atom("ping"), x - 1);
-          },
-          others >> [=] {
-            cout << "ping_actor: unexpected: "
-                 << to_string(current_message())
-                 << endl;
-          }
-        );
+      [=](ping_atom, uint32_t value) -> result<pong_atom, uint32_t> {
+        return {pong_atom_v, value};
+      },
+      [=](add_atom, const string& host, uint16_t port) -> result<ok_atom> {
+        auto key = std::make_pair(host, port);
+        if (pongs_.count(key) > 0)
+          return ok_atom_v;
+        auto rp = make_response_promise<ok_atom>();
+        auto mm = system().middleman().actor_handle();
+        auto t0 = std::chrono::steady_clock::now();
+        request(mm, infinite, connect_atom_v, host, port)
+          .then(
+            [=](const node_id&, strong_actor_ptr& ptr,
+                const std::set<string>&) mutable {
+              if (!ptr) {
+                rp.deliver(make_error(sec::no_actor_published_at_port));
+                return;
+              }
+              stats_.connect_ns.emplace_back(
+                to_ns(std::chrono::steady_clock::now() - t0));
+              auto hdl = actor_cast<actor>(std::move(ptr));
+              monitor(hdl);
+              pongs_.emplace(key, std::move(hdl));
+              rp.deliver(ok_atom_v);
+            },
+            [=](error& err) mutable { rp.deliver(std::move(err)); });
+        return rp;
+      },
+      [=](kickoff_atom, uint32_t num_pings, const actor& buddy) {
+        for (auto& kvp : pongs_)
+          send(spawn(ping_actor, buddy), kickoff_atom_v, kvp.second,
+               num_pings);
+      },
+      [=](purge_atom) {
+        pongs_.clear();
+        stats_ = node_stats{};
+      },
+      [=](stats_atom) {
+        auto result = stats_;
+        result.cpu_us = cpu_time_us();
+        result.rss_bytes = rss_bytes();
+        return result;
       },
-      others >> [=] {
-          cout << "ping_actor: unexpected: "
-               << to_string(current_message())
-               << endl;
-      }
     };
   }
 
 private:
-  actor parent_;
+  pong_map pongs_;
+  node_stats stats_;
 };
 
-class server_actor : public event_based_actor {
-public:
-    typedef map<pair<string, uint16_t>, actor> pong_map;
+// -- utility ------------------------------------------------------------------
 
-    behavior make_behavior() override {
-      trap_exit(true);
-      return {
-        on(atom("ping"), arg_match) >> [=](uint32_t value) {
-          return make_tuple(atom("pong"), value);
-        },
-        on(atom("add_pong"), arg_match) >> [=](const string& host, uint16_t port) -> message {
-          auto key = make_pair(host, port);
-          auto i = m_pongs.find(key);
-          if (i == m_pongs.end()) {
-            try {
-              auto p = system().middleman().remote_actor(host.c_str(), port);
-              link_to(p);
-              m_pongs.insert(make_pair(key, p));
-            }
-            catch (exception& e) {
-              return make_message(atom("error"), e.what());
-            }
-          }
-          return make_message(atom("ok"));
-        },
-        on(atom("kickoff"), arg_match) >> [=](uint32_t num_pings, actor buddy) {
-          for (auto& kvp : m_pongs) {
-            auto ping = spawn<ping_actor>(buddy);
-            send(ping, atom("kickoff"), kvp.second, num_pings);
-          }
-        },
-        on(atom("purge")) >> [=] {
-            m_pongs.clear();
-        },
-        on<atom("EXIT"), uint32_t>() >> [=] {
-          auto who = current_sender();
-          auto i = find_if(m_pongs.begin(), m_pongs.end(),
-                           [&](const pong_map::value_type& kvp) {
-            return kvp.second == who;
-          });
-          if (i != m_pongs.end())
-            m_pongs.erase(i);
-        },
-        on(atom("shutdown")) >> [=] {
-          m_pongs.clear();
-          quit();
-        },
-        others >> [=] {
-          cout << "unexpected: " << to_string(current_message()) << endl;
-        }
-    };
+struct config : actor_system_config {
+  config(pinning_policy pin) {
+#if CAF_VERSION < 1800
+    add_message_type<node_stats>("node_stats");
+#endif
+    load<io::middleman>();
+    add_pinning_hook(*this, pin);
   }
-
-private:
-  pong_map m_pongs;
 };
 
-template<typename Arg0>
-void usage(Arg0&& arg0) {
-  cout << forward<Arg0>(arg0) << endl << endl;
-  usage();
+bool parse_endpoint(const string& str, endpoint& x) {
+  auto sep = str.rfind(':');
+  if (sep == string::npos)
+    return false;
+  auto port = atoi(str.c_str() + sep + 1);
+  if (port <= 0 || port >= 65536)
+    return false;
+  x.host = str.substr(0, sep);
+  x.port = static_cast<uint16_t>(port);
+  return true;
 }
 
-template<typename Arg0, typename Arg1, typename... Args>
-void usage(Arg0&& arg0, Arg1&& arg1, Args&&... args) {
-  cout << forward<Arg0>(arg0);
-  usage(forward<Arg1>(arg1), forward<Args>(args)...);
+/// Collects the stats of all servers or returns an empty vector on error.
+vector<node_stats> collect_stats(scoped_actor& self,
+                                 const vector<actor>& servers) {
+  vector<node_stats> result;
+  for (auto& x : servers) {
+    auto failed = false;
+    self->request(x, std::chrono::seconds(10), stats_atom_v)
+      .receive([&](node_stats& st) { result.emplace_back(std::move(st)); },
+               [&](const error& err) {
+                 cerr << "cannot query stats: " << to_string(err) << endl;
+                 failed = true;
+               });
+    if (failed)
+      return {};
+  }
+  return result;
 }
 
-template<typename Iterator>
-void server_mode(Iterator first, Iterator last) {
-  string port_prefix = "--port=";
-  // extracts port from a key-value pair
-  auto kvp_port = [&](const string& str) -> maybe<int> {
-    if (equal(port_prefix.begin(), port_prefix.end(), str.begin())) {
-      return spro<int>(str.c_str() + port_prefix.size());
-    }
-    return {};
-  };
-  message_builder{first, last}.apply({
-    (on(kvp_port) || on("-p", spro<int>)) >> [](int port) {
-      if (port > 1024 && port < 65536)
-        io::publish(spawn<server_actor>(), static_cast<uint16_t>(port));
-      else
-        usage("illegal port: ", port);
-    },
-    others >> [=] {
-      if (first != last) usage("illegal argument: ", *first);
-      else usage();
-    }
-  });
+/// Prints the p50, p99 and maximum of `xs` in microseconds.
+void print_us(const char* label, sample_set& xs) {
+  cout << label << " p50 " << xs.percentile(50) / 1000 << " us, p99 "
+       << xs.percentile(99) / 1000 << " us, max " << xs.percentile(100) / 1000
+       << " us" << endl;
 }
 
-template<typename Iterator>
-void client_mode(Iterator first, Iterator last) {
-  if (first == last)
-    usage("no server, no fun");
-  uint32_t init_value = 0;
-  vector<pair<string, uint16_t> > remotes;
-  string pings_prefix = "--num_pings=";
-  auto num_msgs = [&](const string& str) -> maybe<int> {
-    if (equal(pings_prefix.begin(), pings_prefix.end(), str.begin())) {
-      return spro<int>(str.c_str() + pings_prefix.size());
+/// Measures plain TCP connects to each server as baseline for the connect
+/// times of the servers. Runs before the setup phase, since the blocking
+/// connects would otherwise inflate the measured mesh setup.
+sample_set tcp_baseline(const vector<endpoint>& remotes) {
+  sample_set result;
+  // one connect per link that ends at the server
+  for (auto& r : remotes) {
+    for (size_t k = 1; k < remotes.size(); ++k) {
+      auto ns = tcp_connect_ns(r.host, r.port);
+      if (ns >= 0)
+        result.add(ns);
     }
-    return {};
-  };
-  vector<string> vec;
-  for (auto i = first; i != last; ++i) {
-    vec.clear();
-    split(vec, *i, is_any_of(":"), token_compress_on);
-    message_builder{vec.begin(), vec.end()}.apply({
-      on(val<string>, spro<int>) >> [&](string& host, int port) {
-        if (port <= 1024 || port >= 65536) {
-          throw invalid_argument("illegal port: " + to_string(port));
-        }
-        remotes.emplace_back(move(host), static_cast<uint16_t>(port));
-      },
-      on(num_msgs) >> [&](int num) {
-        if (num > 0) init_value = static_cast<uint32_t>(num);
-      }
-    });
-  }
-  if (init_value == 0) {
-      cout << "no non-zero, non-negative init value given" << endl;
-      exit(1);
-  }
-  if (remotes.size() < 2) {
-      cout << "less than two nodes given" << endl;
-      exit(1);
   }
-  vector<actor> remote_actors;
+  return result;
+}
+
+/// Tells each server to connect to all other servers, lets each server ping
+/// all other servers `num_pings` times and waits for all pings to finish.
+/// Prints the time for setting up the full mesh, the per-peer connect times,
+/// the message throughput as well as CPU and memory use of the servers.
+bool run_benchmark(actor_system& sys, const vector<endpoint>& remotes,
+                   uint32_t num_pings, bool parallel_setup) {
+  using clock = std::chrono::steady_clock;
+  vector<actor> servers;
   for (auto& r : remotes) {
-      remote_actors.push_back(io::remote_actor(r.first.c_str(), r.second));
-  }
-  // setup phase
-  scoped_actor self;
-  //cout << "tell server nodes to connect to each other" << endl;
-  for (size_t i = 0; i < remotes.size(); ++i) {
-      for (size_t j = 0; j < remotes.size(); ++j) {
-          if (i != j) {
-              auto& r = remotes[j];
-              self->send(remote_actors[i], atom("add_pong"),
-                               r.first, r.second);
-          }
-      }
+    auto hdl = sys.middleman().remote_actor(r.host, r.port);
+    if (!hdl) {
+      cerr << "cannot connect to " << r.host << ":" << r.port << ": "
+           << to_string(hdl.error()) << endl;
+      return false;
+    }
+    servers.emplace_back(std::move(*hdl));
   }
-  { // collect {ok} messages
-      size_t i = 0;
-      size_t end = remote_actors.size() * (remote_actors.size() - 1);
-      self->receive_for(i, end) (
-          on(atom("ok")) >> [] {
-              // nothing to do
-          },
-          on(atom("error"), arg_match) >> [&](const string& str) {
-              cout << "error: " << str << endl;
-              for (auto& x : remote_actors) {
-                  self->send(x, atom("purge"));
-              }
-              throw logic_error("");
-          },
-          others >> [&] {
-              cout << "expected {ok|error}, received: "
-                   << to_string(self->current_message())
+  scoped_actor self{sys};
+  auto purge_all = [&] {
+    for (auto& x : servers)
+      self->send(x, purge_atom_v);
+  };
+  purge_all();
+  auto tcp = tcp_baseline(remotes);
+  auto before_setup = collect_stats(self, servers);
+  if (before_setup.empty())
+    return false;
+  // setup phase: tell server nodes to connect to each other
+  auto num_links = servers.size() * (servers.size() - 1);
+  auto failed = false;
+  auto on_error = [&](const error& err) {
+    cerr << "error: " << to_string(err) << endl;
+    failed = true;
+  };
+  auto setup_start = clock::now();
+  if (parallel_setup) {
+    // the responses arrive as regular messages when using send
+    for (size_t i = 0; i < servers.size(); ++i)
+      for (size_t j = 0; j < servers.size(); ++j)
+        if (i != j)
+          self->send(servers[i], add_atom_v, remotes[j].host, remotes[j].port);
+    // count the responses per server to report unresponsive nodes
+    vector<size_t> answers(servers.size());
+    size_t num_answers = 0;
+    auto count_answer = [&] {
+      auto sender = actor_cast<actor>(self->current_sender());
+      auto k = std::find(servers.begin(), servers.end(), sender);
+      if (k != servers.end())
+        ++answers[static_cast<size_t>(k - servers.begin())];
+      ++num_answers;
+    };
+    // a timeout in receive_while would restart with each message, so we
+    // receive one message at a time and pass the remaining time until the
+    // deadline to each receive
+    auto deadline = clock::now() + std::chrono::seconds(10);
+    auto timed_out = false;
+    while (num_answers < num_links && !timed_out) {
+      auto remaining = std::max(deadline - clock::now(), clock::duration{0});
+      self->receive(
+        [&](ok_atom) { count_answer(); },
+        [&](const error& err) {
+          count_answer();
+          on_error(err);
+        },
+        after(remaining) >> [&] {
+          for (size_t k = 0; k < servers.size(); ++k)
+            if (answers[k] < servers.size() - 1)
+              cerr << remotes[k].host << ":" << remotes[k].port
+                   << " didn't connect to " << servers.size() - 1 - answers[k]
+                   << " of " << servers.size() - 1 << " peers within 10s"
                    << endl;
-              throw logic_error("");
-          },
-          after(chrono::seconds(10)) >> [&] {
-              cout << "remote didn't answer within 10sec." << endl;
-              for (auto& x : remote_actors) {
-                  self->send(x, atom("purge"));
-              }
-              throw logic_error("");
-          }
-      );
+          timed_out = true;
+          failed = true;
+        });
+    }
+  } else {
+    for (size_t i = 0; i < servers.size() && !failed; ++i)
+      for (size_t j = 0; j < servers.size() && !failed; ++j)
+        if (i != j)
+          self
+            ->request(servers[i], std::chrono::seconds(10), add_atom_v,
+                      remotes[j].host, remotes[j].port)
+            .receive(
+              [](ok_atom) {
+                // nop
+              },
+              on_error);
+  }
+  auto setup_stop = clock::now();
+  if (failed) {
+    purge_all();
+    return false;
   }
+  auto after_setup = collect_stats(self, servers);
   // kickoff
-  //cout << "setup done" << endl;
-  //cout << "kickoff, init value = " << init_value << endl;
-  for (auto& r : remote_actors) {
-      self->send(r, atom("kickoff"), init_value, self);
+  auto start = clock::now();
+  for (auto& x : servers)
+    self->send(x, kickoff_atom_v, num_pings, actor{self});
+  // collect done messages
+  size_t i = 0;
+  self->receive_for(i, num_links)([](done_atom) {
+    // nop
+  });
+  auto stop = clock::now();
+  auto after_run = collect_stats(self, servers);
+  purge_all();
+  if (after_setup.empty() || after_run.empty())
+    return false;
+  // print results
+  using std::chrono::milliseconds;
+  auto run_ms = std::chrono::duration_cast<milliseconds>(stop - start).count();
+  cout << servers.size() << " nodes, " << num_pings
+       << " pings per pair: " << run_ms << " ms" << endl;
+  cout << "  mesh setup (" << num_links << " connections, "
+       << (parallel_setup ? "parallel" : "sequential") << "): "
+       << std::chrono::duration_cast<milliseconds>(setup_stop - setup_start)
+            .count()
+       << " ms" << endl;
+  sample_set connect;
+  sample_set handshake;
+  // subtract the typical TCP connect to estimate the BASP handshake
+  auto tcp_p50 = tcp.percentile(50);
+  for (auto& st : after_setup) {
+    for (auto ns : st.connect_ns) {
+      connect.add(ns);
+      handshake.add(std::max(int64_t{0}, ns - tcp_p50));
+    }
   }
-  { // collect {done} messages
-      size_t i = 0;
-      size_t end = remote_actors.size() * (remote_actors.size() - 1);
-      self->receive_for(i, end) (
-          on(atom("done")) >> [] {
-              //cout << "...done..." << endl;
-          },
-          others >> [&] {
-              cout << "unexpected: "
-                   << to_string(self->current_message()) << endl;
-              throw logic_error("");
-          }
-      );
+  print_us("  connect per peer:", connect);
+  print_us("    tcp connect:   ", tcp);
+  print_us("    handshake:     ", handshake);
+  // each ping-pong round trip consists of two messages
+  auto msgs = 2.0 * num_links * num_pings;
+  auto run_s = std::max(1.0, static_cast<double>(to_ns(stop - start))) / 1e9;
+  cout << "  throughput: " << static_cast<int64_t>(msgs / run_s)
+       << " msgs/s" << endl;
+  sample_set cpu_setup;
+  sample_set cpu_run;
+  int64_t rss_delta = 0;
+  for (size_t k = 0; k < servers.size(); ++k) {
+    cpu_setup.add(after_setup[k].cpu_us - before_setup[k].cpu_us);
+    cpu_run.add(after_run[k].cpu_us - after_setup[k].cpu_us);
+    rss_delta += after_setup[k].rss_bytes - before_setup[k].rss_bytes;
   }
+  auto setup_us = static_cast<double>(to_ns(setup_stop - setup_start)) / 1e3;
+  auto pct = [](double cpu_us, double wall_us) {
+    return wall_us > 0 ? 100.0 * cpu_us / wall_us : 0.0;
+  };
+  cout << "  cpu per node during setup: avg " << pct(cpu_setup.mean(), setup_us)
+       << "%, max " << pct(cpu_setup.percentile(100), setup_us) << "%" << endl;
+  cout << "  cpu per node during run: avg " << pct(cpu_run.mean(), run_s * 1e6)
+       << "%, max " << pct(cpu_run.percentile(100), run_s * 1e6) << "%" << endl;
+  // BASP closes redundant connections, i.e., each pair of nodes shares a
+  // single TCP connection even though both nodes connect to each other
+  auto num_connections = static_cast<int64_t>(num_links / 2);
+  cout << "  rss per connection: " << rss_delta / num_connections / 1024
+       << " KiB" << endl;
+  return true;
 }
 
-template<typename Iterator>
-void shutdown_mode(Iterator first, Iterator last) {
-  vector<pair<string, uint16_t> > remotes;
+/// Sends an exit message to each server and waits for it to terminate.
+void shutdown_servers(actor_system& sys, const vector<endpoint>& remotes) {
+  scoped_actor self{sys};
+  for (auto& r : remotes) {
+    auto hdl = sys.middleman().remote_actor(r.host, r.port);
+    if (!hdl) {
+      cerr << "couldn't shutdown " << r.host << ":" << r.port
+           << "; reason: " << to_string(hdl.error()) << endl;
+      continue;
+    }
+    self->monitor(*hdl);
+    self->send_exit(*hdl, exit_reason::user_shutdown);
+    self->receive(
+      [](const down_msg&) {
+        // ok, done
+      },
+      after(std::chrono::seconds(10)) >> [&] {
+        cerr << r.host << ":" << r.port << " didn't shut down within 10s"
+             << endl;
+      });
+  }
+}
 
+// -- program modes ------------------------------------------------------------
 
-  vector<string> vec;
-  for (auto i = first; i != last; ++i) {
-    vec.clear();
-    split(vec, *i, is_any_of(":"), token_compress_on);
-    message_builder{vec.begin(), vec.end()}.apply({
-      on(val<string>, spro<int>) >> [&](string& host, int port) {
-        if (port <= 1024 || port >= 65536) {
-          throw invalid_argument("illegal port: " + to_string(port));
-        }
-        remotes.emplace_back(move(host), static_cast<uint16_t>(port));
-      }
-    });
+/// Publishes a server actor at `port` and passes the actual port to `report`.
+/// Returns after the server actor terminated.
+template <class F>
+int run_server(pinning_policy pin, uint16_t port, F report) {
+  config cfg{pin};
+  actor_system sys{cfg};
+  auto server = sys.spawn<server_actor>();
+  auto actual_port = sys.middleman().publish(server, port);
+  if (!actual_port) {
+    cerr << "cannot publish server at port " << port << ": "
+         << to_string(actual_port.error()) << endl;
+    anon_send_exit(server, exit_reason::user_shutdown);
+    return EXIT_FAILURE;
   }
-  scoped_actor self;
-  for (auto& r : remotes) {
-    try {
-      auto x = io::remote_actor(r.first, r.second);
-      self->monitor(x);
-      self->send(x, atom("shutdown"));
-      self->receive (
-        on(atom("DOWN"), val<uint32_t>) >> [] {
-          // ok, done
-        },
-        after(chrono::seconds(10)) >> [&] {
-          cerr << r.first << ":" << r.second << " didn't shut down "
-               << "within 10s"
-               << endl;
-        }
-      );
+  report(*actual_port);
+  return EXIT_SUCCESS;
+}
+
+int server_mode(pinning_policy pin, int argc, char** argv) {
+  int port = 0;
+  if (auto str = take_arg(argc, argv, "port"))
+    port = atoi(str->c_str());
+  else if (argc == 3 && strcmp(argv[1], "-p") == 0)
+    port = atoi(argv[2]);
+  else if (argc > 1)
+    return usage("illegal argument: ", argv[1]);
+  else
+    return usage();
+  if (port <= 1024 || port >= 65536)
+    return usage("illegal port: ", port);
+  return run_server(pin, static_cast<uint16_t>(port), [&](uint16_t) {
+    cout << "server published at port " << port << endl;
+  });
+}
+
+/// Removes the --setup option from the command line.
+bool take_setup_mode(int& argc, char** argv, bool& parallel) {
+  parallel = true;
+  if (auto str = take_arg(argc, argv, "setup")) {
+    if (*str == "sequential")
+      parallel = false;
+    else if (*str != "parallel")
+      return false;
+  }
+  return true;
+}
+
+int client_mode(pinning_policy pin, int argc, char** argv) {
+  uint32_t num_pings = 0;
+  bool parallel = true;
+  if (!take_setup_mode(argc, argv, parallel))
+    return usage("illegal setup mode");
+  if (auto str = take_arg(argc, argv, "num_pings"))
+    num_pings = static_cast<uint32_t>(atoi(str->c_str()));
+  if (num_pings == 0)
+    return usage("no non-zero, non-negative init value given");
+  vector<endpoint> remotes;
+  for (int i = 1; i < argc; ++i) {
+    endpoint x;
+    if (!parse_endpoint(argv[i], x))
+      return usage("illegal argument: ", argv[i]);
+    remotes.emplace_back(std::move(x));
+  }
+  if (remotes.size() < 2)
+    return usage("less than two nodes given");
+  config cfg{pin};
+  actor_system sys{cfg};
+  return run_benchmark(sys, remotes, num_pings, parallel) ? EXIT_SUCCESS
+                                                          : EXIT_FAILURE;
+}
+
+int launch_mode(pinning_policy pin, int argc, char** argv) {
+  uint32_t num_pings = 0;
+  size_t num_nodes = 2;
+  bool parallel = true;
+  if (!take_setup_mode(argc, argv, parallel))
+    return usage("illegal setup mode");
+  std::unique_ptr<tcp_relay_set> relays;
+  if (auto str = take_arg(argc, argv, "shape")) {
+    shaping cfg;
+    if (!parse_shaping(*str, cfg))
+      return usage("illegal shaping spec: ", *str);
+    relays = std::make_unique<tcp_relay_set>(cfg);
+  }
+  if (auto str = take_arg(argc, argv, "num_pings"))
+    num_pings = static_cast<uint32_t>(atoi(str->c_str()));
+  if (auto str = take_arg(argc, argv, "nodes"))
+    num_nodes = static_cast<size_t>(atoi(str->c_str()));
+  if (argc > 1)
+    return usage("illegal argument: ", argv[1]);
+  if (num_pings == 0)
+    return usage("no non-zero, non-negative init value given");
+  if (num_nodes < 2 || num_nodes > 64)
+    return usage("number of nodes must be between 2 and 64");
+  // fork all servers before starting any thread in this process
+  vector<child_node> children;
+  vector<endpoint> remotes;
+  for (size_t i = 0; i < num_nodes; ++i) {
+    auto child = fork_node([pin](auto report) {
+      return run_server(pin, 0, report);
+    });
+    if (child.pid > 0)
+      children.emplace_back(child);
+    if (child.port == 0) {
+      cerr << "failed to launch server process " << i << endl;
+      break;
     }
-    catch (std::exception& e) {
-      cerr << "couldn't shutdown " << r.first << ":" << r.second
-           << "; reason: " << e.what()
-           << endl;
+    remotes.emplace_back(endpoint{"127.0.0.1", child.port});
+  }
+  // start relays only after forking, since they run on their own threads
+  auto routed = remotes;
+  auto failed_relays = false;
+  if (relays && remotes.size() == num_nodes) {
+    for (auto& r : routed) {
+      r.port = relays->add(r.host, r.port);
+      failed_relays = failed_relays || r.port == 0;
     }
   }
+  auto result = EXIT_FAILURE;
+  {
+    config cfg{pin};
+    actor_system sys{cfg};
+    if (remotes.size() == num_nodes && !failed_relays
+        && run_benchmark(sys, routed, num_pings, parallel))
+      result = EXIT_SUCCESS;
+    shutdown_servers(sys, remotes);
+  }
+  for (auto& child : children)
+    wait_for(child);
+  return result;
 }
 
-} // namespace <anonymous>
+int shutdown_mode(pinning_policy pin, int argc, char** argv) {
+  vector<endpoint> remotes;
+  for (int i = 1; i < argc; ++i) {
+    endpoint x;
+    if (!parse_endpoint(argv[i], x))
+      return usage("illegal argument: ", argv[i]);
+    remotes.emplace_back(std::move(x));
+  }
+  config cfg{pin};
+  actor_system sys{cfg};
+  shutdown_servers(sys, remotes);
+  return EXIT_SUCCESS;
+}
+
+} // namespace
 
 int main(int argc, char** argv) {
-    if (argc < 2) usage();
-    auto first = argv + 1;
-    auto last = argv + argc;
-    message_builder{first, first + 1}.apply({
-      on("mode=server") >> [=] {
-        server_mode(first + 1, last);
-      },
-      on("mode=benchmark") >> [=] {
-        client_mode(first + 1, last);
-      },
-      on("mode=shutdown") >> [=] {
-        shutdown_mode(first + 1, last);
-      },
-      (on("-h") || on("--help")) >> [] {
-        usage();
-      },
-      others >> [=] {
-        usage("unknown argument: ", *first);
-      }
-    });
-    await_all_actors_done();
-    shutdown();
+#if CAF_VERSION >= 1800
+  init_global_meta_objects<id_block::distributed>();
+  io::middleman::init_global_meta_objects();
+  core::init_global_meta_objects();
+#endif
+  pinning_policy pin;
+  if (!take_pinning_policy(argc, argv, pin) || argc < 2)
+    return usage();
+  string mode = argv[1];
+  // drop the program name, i.e., argv[0] of each mode is the mode itself
+  auto mode_argc = argc - 1;
+  auto mode_argv = argv + 1;
+  if (mode == "mode=server")
+    return server_mode(pin, mode_argc, mode_argv);
+  if (mode == "mode=benchmark")
+    return client_mode(pin, mode_argc, mode_argv);
+  if (mode == "mode=launch")
+    return launch_mode(pin, mode_argc, mode_argv);
+  if (mode == "mode=shutdown")
+    return shutdown_mode(pin, mode_argc, mode_argv);
+  if (mode == "-h" || mode == "--help")
+    return usage();
+  return usage("unknown argument: ", mode);
 }
@@ -0,0 +1,289 @@
+/******************************************************************************
+ *                       ____    _    _____                                   *
+ *                      / ___|  / \  |  ___|    C++                           *
+ *                     | |     / _ \ | |_       Actor                         *
+ *                     | |___ / ___ \|  _|      Framework                     *
+ *                      \____/_/   \_|_|                                      *
+ *                                                                            *
+ * Copyright (C) 2011 - 2017                                                  *
+ * Dominik Charousset <dominik.charousset (at) haw-hamburg.de>                *
+ *                                                                            *
+ * Distributed under the terms and conditions of the BSD 3-Clause License or  *
+ * (at your option) under the terms and conditions of the Boost Software      *
+ * License 1.0. See accompanying files LICENSE and LICENSE_ALTERNATIVE.       *
+ *                                                                            *
+ * If you did not receive a copy of the license files, see                    *
+ * http://opensource.org/licenses/BSD-3-Clause and                            *
+ * http://www.boost.org/LICENSE_1_0.txt.                                      *
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "caf/all.hpp"
+
+#include "thread_pinning.hpp"
+
+#if CAF_VERSION < 1800
+
+using work_atom = caf::atom_constant<caf::atom("work")>;
+using report_atom = caf::atom_constant<caf::atom("report")>;
+static constexpr work_atom work_atom_v = work_atom::value;
+static constexpr report_atom report_atom_v = report_atom::value;
+
+#else
+
+CAF_BEGIN_TYPE_ID_BLOCK(fairness, first_custom_type_id)
+
+  CAF_ADD_ATOM(fairness, work_atom);
+  CAF_ADD_ATOM(fairness, report_atom);
+
+CAF_END_TYPE_ID_BLOCK(fairness)
+
+#endif
+
+#if CAF_VERSION < 1700
+using settings = caf::dictionary<caf::config_value::dictionary>;
+#endif
+
+using namespace caf;
+using namespace std::chrono;
+
+using hrc = high_resolution_clock;
+
+namespace {
+
+/// Performs `units` rounds of busy work.
+void burn(uint64_t units) {
+  volatile uint64_t sink = 0;
+  for (uint64_t i = 0; i < units * 1000; ++i)
+    sink = sink + i;
+}
+
+/// Bounces each message back to its sender. Routing the work items of a
+/// tenant through a reflector allows the tenant's mailbox to run empty, i.e.,
+/// the number of messages in flight determines the message rate of a tenant.
+behavior reflector() {
+  return {
+    [](work_atom x) { return x; },
+  };
+}
+
+/// Processes work items until reaching the deadline and tracks its progress
+/// as well as the longest time between two consecutive work items.
+class tenant : public event_based_actor {
+public:
+  tenant(actor_config& cfg, uint64_t id, uint64_t in_flight, uint64_t work,
+         hrc::time_point deadline, actor collector)
+    : event_based_actor(cfg),
+      id_(id),
+      in_flight_(in_flight),
+      work_(work),
+      deadline_(deadline),
+      collector_(std::move(collector)),
+      processed_(0),
+      max_gap_(0) {
+    // nop
+  }
+
+  behavior make_behavior() override {
+    reflector_ = spawn(reflector);
+    for (uint64_t i = 0; i < in_flight_; ++i)
+      send(reflector_, work_atom_v);
+    last_ = hrc::now();
+    return {
+      [=](work_atom x) {
+        auto now = hrc::now();
+        max_gap_ = std::max(max_gap_, now - last_);
+        last_ = now;
+        if (now >= deadline_) {
+          auto gap = duration_cast<nanoseconds>(max_gap_).count();
+          send(collector_, report_atom_v, id_, processed_,
+               static_cast<int64_t>(gap));
+          send_exit(reflector_, exit_reason::user_shutdown);
+          quit();
+          return;
+        }
+        ++processed_;
+        burn(work_);
+        send(reflector_, x);
+      },
+    };
+  }
+
+private:
+  uint64_t id_;
+  uint64_t in_flight_;
+  uint64_t work_;
+  hrc::time_point deadline_;
+  actor collector_;
+  actor reflector_;
+  uint64_t processed_;
+  hrc::duration max_gap_;
+  hrc::time_point last_;
+};
+
+struct run_result {
+  /// Jain's fairness index over the number of processed items per tenant,
+  /// i.e., 1 if all tenants get the same service regardless of how many
+  /// items they keep in flight. Drops when hot tenants crowd out cold ones.
+  double jain;
+  /// Jain's index over the processed items per item in flight (demand), i.e.,
+  /// 1 if each tenant gets service proportional to its demand.
+  double jain_per_demand;
+  /// Average number of processed items per hot tenant.
+  double hot_avg;
+  /// Average number of processed items per cold tenant.
+  double cold_avg;
+  /// Longest time any tenant had to wait between two work items.
+  int64_t worst_gap_ns;
+  /// Sum of all processed work items.
+  uint64_t total;
+};
+
+struct params {
+  size_t threads = std::max(std::thread::hardware_concurrency() / 2, 1u);
+  uint64_t tenants = 32;
+  uint64_t hot = 8;
+  uint64_t hot_load = 64;
+  uint64_t work = 1;
+  size_t duration_ms = 1000;
+  std::string throughputs = "1,10,100,1000,max";
+  std::string pin = "none";
+  pinning_policy policy = pinning_policy::none;
+};
+
+double jain_index(const std::vector<double>& xs) {
+  double sum = 0;
+  double sum_sq = 0;
+  for (auto x : xs) {
+    sum += x;
+    sum_sq += x * x;
+  }
+  return sum_sq > 0 ? (sum * sum) / (xs.size() * sum_sq) : 0.0;
+}
+
+run_result run(const params& ps, size_t max_throughput) {
+  actor_system_config cfg;
+  add_pinning_hook(cfg, ps.policy);
+#if CAF_VERSION >= 1800
+  cfg.set("caf.scheduler.max-threads", ps.threads);
+  if (max_throughput != std::numeric_limits<size_t>::max())
+    cfg.set("caf.scheduler.max-throughput", max_throughput);
+#else
+  cfg.set("scheduler.max-threads", ps.threads);
+  if (max_throughput != std::numeric_limits<size_t>::max())
+    cfg.set("scheduler.max-throughput", max_throughput);
+#endif
+  actor_system system{cfg};
+  scoped_actor self{system};
+  auto deadline = hrc::now() + milliseconds{ps.duration_ms};
+  for (uint64_t i = 0; i < ps.tenants; ++i) {
+    auto in_flight = i < ps.hot ? ps.hot_load : uint64_t{1};
+    system.spawn<tenant>(i, in_flight, ps.work, deadline, actor{self});
+  }
+  std::vector<uint64_t> processed(ps.tenants);
+  int64_t worst_gap = 0;
+  uint64_t received = 0;
+  self->receive_for(received, ps.tenants)(
+    [&](report_atom, uint64_t id, uint64_t n, int64_t gap) {
+      processed[id] = n;
+      worst_gap = std::max(worst_gap, gap);
+    });
+  uint64_t total = 0;
+  uint64_t hot_total = 0;
+  std::vector<double> raw;
+  std::vector<double> per_demand;
+  for (uint64_t i = 0; i < ps.tenants; ++i) {
+    total += processed[i];
+    if (i < ps.hot)
+      hot_total += processed[i];
+    auto in_flight = i < ps.hot ? ps.hot_load : uint64_t{1};
+    raw.push_back(static_cast<double>(processed[i]));
+    per_demand.push_back(static_cast<double>(processed[i]) / in_flight);
+  }
+  auto num_cold = ps.tenants - ps.hot;
+  auto hot_avg = ps.hot > 0 ? static_cast<double>(hot_total) / ps.hot : 0.0;
+  auto cold_avg = num_cold > 0
+                    ? static_cast<double>(total - hot_total) / num_cold
+                    : 0.0;
+  return {jain_index(raw), jain_index(per_demand), hot_avg, cold_avg,
+          worst_gap, total};
+}
+
+std::vector<size_t> parse_throughputs(const std::string& str) {
+  std::vector<size_t> result;
+  std::istringstream in{str};
+  std::string x;
+  while (std::getline(in, x, ','))
+    if (x == "max")
+      result.push_back(std::numeric_limits<size_t>::max());
+    else
+      result.push_back(static_cast<size_t>(std::stoull(x)));
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+#if CAF_VERSION >= 1800
+  init_global_meta_objects<caf::id_block::fairness>();
+  core::init_global_meta_objects();
+#endif
+  params ps;
+  config_option_set options;
+  config_option_adder{options, "global"}
+    .add<bool>("help,h?", "print this help text")
+    .add(ps.threads, "threads,t", "number of threads for the scheduler")
+    .add(ps.tenants, "tenants,n", "number of competing actors")
+    .add(ps.hot, "hot", "number of tenants with a high message rate")
+    .add(ps.hot_load, "hot-load", "messages in flight per hot tenant")
+    .add(ps.work, "work,w", "busy-work units per message")
+    .add(ps.duration_ms, "duration,d", "runtime per configuration in ms")
+    .add(ps.throughputs, "max-throughput,m",
+         "comma-separated list of max. messages per actor run (or 'max')")
+    .add(ps.pin, "pin", "pin scheduler workers (none|compact|scatter|physical)");
+  settings conf;
+  auto res = options.parse(conf, {argv + 1, argv + argc});
+  if (res.first != caf::pec::success) {
+    std::cerr << "error while parsing argument \"" << *res.second
+              << "\": " << to_string(res.first) << "\n\n";
+    std::cerr << options.help_text() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (get_or(conf, "help", false)) {
+    std::cout << options.help_text() << std::endl;
+    return EXIT_SUCCESS;
+  }
+  if (!from_string(ps.pin, ps.policy)) {
+    std::cerr << "unknown pinning policy: " << ps.pin << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (ps.tenants == 0 || ps.hot > ps.tenants) {
+    std::cerr << "need at least one tenant and at most as many hot tenants"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "max_throughput jain_index jain_per_demand hot_avg_msgs "
+               "cold_avg_msgs worst_starvation_ms total_msgs"
+            << std::endl;
+  for (auto x : parse_throughputs(ps.throughputs)) {
+    auto r = run(ps, x);
+    if (x == std::numeric_limits<size_t>::max())
+      std::cout << "max";
+    else
+      std::cout << x;
+    std::cout << ' ' << std::fixed << std::setprecision(4) << r.jain << ' '
+              << r.jain_per_demand << ' ' << std::setprecision(1) << r.hot_avg
+              << ' ' << r.cold_avg << ' ' << std::setprecision(3)
+              << r.worst_gap_ns / 1e6 << ' ' << r.total << std::endl;
+  }
+}
@@ -24,6 +24,8 @@
 
 #include "caf/all.hpp"
 
+#include "thread_pinning.hpp"
+
 #if CAF_VERSION < 1800
 
 using msg_atom = caf::atom_constant<caf::atom("msg")>;
@@ -75,13 +77,16 @@ void sender(actor whom, uint64_t count) {
 }
 
 int usage() {
-  std::cout << "usage: mailbox_performance NUM_THREADS MSGS_PER_THREAD\n\n";
+  std::cout << "usage: mailbox_performance [--pin=POLICY] NUM_THREADS "
+               "MSGS_PER_THREAD\n\n"
+            << pinning_usage << '\n';
   return 1;
 }
 
-void run(int argc, char** argv, uint64_t num_sender, uint64_t num_msgs) {
+void run(pinning_policy pin, uint64_t num_sender, uint64_t num_msgs) {
   auto total = num_sender * num_msgs;
   actor_system_config cfg;
+  add_pinning_hook(cfg, pin);
   actor_system system{cfg};
   auto testee = system.spawn<receiver>(total);
   for (uint64_t i = 0; i < num_sender; ++i)
@@ -91,12 +96,13 @@ void run(int argc, char** argv, uint64_t num_sender, uint64_t num_msgs) {
 } // namespace <anonymous>
 
 int main(int argc, char** argv) {
-  if (argc != 3)
+  pinning_policy pin;
+  if (!take_pinning_policy(argc, argv, pin) || argc != 3)
     return usage();
 #if CAF_VERSION >= 1800
   init_global_meta_objects<caf::id_block::mailbox_performance>();
   core::init_global_meta_objects();
 #endif
-  run(argc, argv, static_cast<uint64_t>(std::stoll(argv[1])),
+  run(pin, static_cast<uint64_t>(std::stoll(argv[1])),
       static_cast<uint64_t>(std::stoll(argv[2])));
 }
@@ -7,12 +7,17 @@
 
 #include "caf/all.hpp"
 
+#include "thread_pinning.hpp"
+
 using namespace std;
 using namespace caf;
 
 int main(int argc, char* argv[]) {
-  if (argc != 2)
-    return cout << "usage: ./" << argv[0] << " N" << endl, 1;
+  pinning_policy pin;
+  if (!take_pinning_policy(argc, argv, pin) || argc != 2)
+    return cout << "usage: ./" << argv[0] << " [--pin=POLICY] N" << endl
+                << pinning_usage,
+           1;
   const size_t N              = static_cast<size_t>(atoi(argv[1]));
   const size_t width          = N;
   const size_t height         = N;
@@ -29,6 +34,7 @@ int main(int argc, char* argv[]) {
     }
   }
   actor_system_config cfg;
+  add_pinning_hook(cfg, pin);
   actor_system system{cfg};
   for (size_t y = 0; y < height; ++y) {
     uint8_t* line = &buffer[y * max_x];
@@ -0,0 +1,304 @@
+// Flow-API counterparts of the benchmarks in streaming.cpp. CAF 0.19 replaced
+// the attach_stream_* API with caf::flow observables, i.e., this file and
+// streaming.cpp never compile against the same CAF version. Both use the same
+// benchmark arguments and report the same counters (elements/s and
+// allocs/element), so their outputs compare side by side.
+//
+// Each actor in a pipeline runs its own flow and passes items to the next
+// actor through an SPSC buffer resource, i.e., every hop is an observe_on
+// from one actor to the next. Across actor systems, the pipeline sends
+// caf::stream handles and each hop consumes them via observe_as.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "caf/all.hpp"
+#include "caf/io/all.hpp"
+
+#include "benchmark_counters.hpp"
+#include "tcp_relay.hpp"
+
+#if CAF_VERSION >= 1900
+
+using std::vector;
+
+using namespace caf;
+
+// -- constants and global state -----------------------------------------------
+
+namespace {
+
+constexpr size_t num_messages = 1'000'000;
+
+/// Capacity of the buffers between two actors.
+constexpr size_t buffer_size = 128;
+
+/// Demand threshold for remote stream hops.
+constexpr size_t min_request_size = 32;
+
+/// Maximum delay before a remote stream hop ships an incomplete batch.
+constexpr auto max_batch_delay = std::chrono::milliseconds(5);
+
+} // namespace
+
+// -- utility for running streaming benchmarks ---------------------------------
+
+void StreamingSettings(benchmark::internal::Benchmark* b) {
+  for (int i = 0; i <= 4; ++i)
+    for (int j = 1; j <= 1'000'000; j *= 10)
+      b->Args({i, j});
+}
+
+using uint64_pull = async::consumer_resource<uint64_t>;
+
+using uint64_push = async::producer_resource<uint64_t>;
+
+// -- actors for local pipelines -----------------------------------------------
+
+void source(event_based_actor* self, uint64_push out, size_t max_messages) {
+  self->make_observable()
+    .iota(uint64_t{0})
+    .take(max_messages)
+    .subscribe(std::move(out));
+}
+
+void stage(event_based_actor* self, uint64_pull in, uint64_push out) {
+  in.observe_on(self)
+    .map([](uint64_t x) { return x; })
+    .subscribe(std::move(out));
+}
+
+void fork_stage(event_based_actor* self, uint64_pull in,
+                vector<uint64_push> outs) {
+  // start pulling only after all sinks have subscribed
+  auto src = in.observe_on(self).share(outs.size());
+  for (auto& out : outs)
+    src.subscribe(std::move(out));
+}
+
+void sink(event_based_actor* self, uint64_pull in) {
+  in.observe_on(self).for_each([](uint64_t) {
+    // nop
+  });
+}
+
+/// Returns a new SPSC buffer resource for connecting two actors.
+std::pair<uint64_pull, uint64_push> make_hop() {
+  return async::make_spsc_buffer_resource<uint64_t>(buffer_size,
+                                                    min_request_size);
+}
+
+// -- fixture for single-system streaming --------------------------------------
+
+struct FixtureBase : benchmark::Fixture {
+  FixtureBase() {
+    caf::io::middleman::init_global_meta_objects();
+    caf::core::init_global_meta_objects();
+  }
+};
+
+/// Creates a new actor system for each run, since Google benchmark
+/// constructs all fixtures during static initialization.
+struct SingleSystem : FixtureBase {
+  std::unique_ptr<actor_system_config> cfg;
+  std::unique_ptr<actor_system> sys;
+
+  void SetUp(const benchmark::State&) override {
+    cfg = std::make_unique<actor_system_config>();
+    sys = std::make_unique<actor_system>(*cfg);
+  }
+
+  void TearDown(const benchmark::State&) override {
+    sys.reset();
+    cfg.reset();
+  }
+};
+
+BENCHMARK_DEFINE_F(SingleSystem, FlowPipeline)(benchmark::State& state) {
+  element_counters counters;
+  for (auto _ : state) {
+    auto [pull, push] = make_hop();
+    sys->spawn(sink, std::move(pull));
+    for (auto i = 0; i < state.range(0); ++i) {
+      auto [next_pull, next_push] = make_hop();
+      sys->spawn(stage, std::move(next_pull), std::move(push));
+      push = std::move(next_push);
+    }
+    sys->spawn(source, std::move(push), static_cast<size_t>(state.range(1)));
+    sys->await_all_actors_done();
+  }
+  counters.report(state, static_cast<uint64_t>(state.range(1)));
+}
+
+BENCHMARK_REGISTER_F(SingleSystem, FlowPipeline)
+    ->Apply(StreamingSettings);
+
+BENCHMARK_DEFINE_F(SingleSystem, FlowFork)(benchmark::State& state) {
+  element_counters counters;
+  for (auto _ : state) {
+    vector<uint64_push> outs;
+    for (auto i = 0; i < state.range(0); ++i) {
+      auto [pull, push] = make_hop();
+      sys->spawn(sink, std::move(pull));
+      outs.emplace_back(std::move(push));
+    }
+    auto [pull, push] = make_hop();
+    sys->spawn(fork_stage, std::move(pull), std::move(outs));
+    sys->spawn(source, std::move(push), static_cast<size_t>(state.range(1)));
+    sys->await_all_actors_done();
+  }
+  counters.report(state,
+                  static_cast<uint64_t>(state.range(0) * state.range(1)));
+}
+
+BENCHMARK_REGISTER_F(SingleSystem, FlowFork)
+    ->Apply(StreamingSettings);
+
+// -- actors for multi-system pipelines ----------------------------------------
+
+behavior remote_stage(event_based_actor* self, actor next_hop) {
+  return {
+    [=](const stream& in) {
+      auto items = self->observe_as<uint64_t>(in, buffer_size,
+                                              min_request_size);
+      self->send(next_hop, self->to_stream("ints", max_batch_delay,
+                                           buffer_size, std::move(items)));
+    },
+  };
+}
+
+behavior remote_sink(event_based_actor* self, actor done_listener) {
+  return {
+    [=](const stream& in) {
+      self->observe_as<uint64_t>(in, buffer_size, min_request_size)
+        .do_on_complete([=] { self->send(done_listener, ok_atom_v); })
+        .for_each([](uint64_t) {
+          // nop
+        });
+    },
+  };
+}
+
+void remote_source(event_based_actor* self, actor first_hop,
+                   size_t max_messages) {
+  auto items = self->make_observable().iota(uint64_t{0}).take(max_messages);
+  self->send(first_hop, self->to_stream("ints", max_batch_delay, buffer_size,
+                                        std::move(items)));
+}
+
+// -- fixture for multi-system streaming ---------------------------------------
+
+/// Honors CAF_BENCH_SHAPE the same way as ManySystems in streaming.cpp.
+template <size_t NumStages>
+struct FlowManySystems : FixtureBase {
+  struct config : actor_system_config {
+    config() {
+      load<io::middleman>();
+    }
+  };
+
+  struct node {
+    config cfg;
+    actor_system sys{cfg};
+    actor hdl;
+    uint16_t port = 0;
+  };
+
+  actor first_hop;
+
+  std::unique_ptr<tcp_relay_set> relays;
+
+  static constexpr size_t num_nodes = NumStages + 2;
+
+  /// Created in SetUp for the same reason as the system of SingleSystem.
+  std::array<std::unique_ptr<node>, num_nodes> nodes;
+
+  std::unique_ptr<scoped_actor> sink_listener;
+
+  template <class T>
+  T unbox(expected<T> x) {
+    if (!x)
+      throw std::runtime_error("unbox failed");
+    return std::move(*x);
+  }
+
+  uint16_t route(uint16_t port) {
+    if (!relays)
+      return port;
+    auto result = relays->add("127.0.0.1", port);
+    if (result == 0)
+      throw std::runtime_error("cannot start relay");
+    return result;
+  }
+
+  void SetUp(const benchmark::State&) override {
+    if (auto spec = getenv("CAF_BENCH_SHAPE")) {
+      shaping cfg;
+      if (!parse_shaping(spec, cfg))
+        throw std::runtime_error("invalid CAF_BENCH_SHAPE");
+      relays = std::make_unique<tcp_relay_set>(cfg);
+    }
+    for (auto& x : nodes)
+      x = std::make_unique<node>();
+    auto& sink_node = *nodes.back();
+    sink_listener = std::make_unique<scoped_actor>(sink_node.sys);
+    sink_node.hdl = sink_node.sys.spawn(remote_sink, actor{*sink_listener});
+    sink_node.port = unbox(sink_node.sys.middleman().publish(sink_node.hdl,
+                                                             0u));
+    for (size_t i = NumStages; i > 0; --i) {
+      auto& x = *nodes[i];
+      auto next_hop = unbox(x.sys.middleman().remote_actor(
+        "127.0.0.1", route(nodes[i + 1]->port)));
+      x.hdl = x.sys.spawn(remote_stage, next_hop);
+      x.port = unbox(x.sys.middleman().publish(x.hdl, 0u));
+    }
+    first_hop = unbox(nodes[0]->sys.middleman().remote_actor(
+      "127.0.0.1", route(nodes[1]->port)));
+  }
+
+  void TearDown(const benchmark::State&) override {
+    first_hop = nullptr;
+    sink_listener.reset();
+    for (auto& x : nodes)
+      if (x)
+        anon_send_exit(x->hdl, exit_reason::user_shutdown);
+    // shut down the systems before the relays between them
+    for (auto& x : nodes)
+      x.reset();
+    relays.reset();
+  }
+
+  void run() {
+    nodes.front()->sys.spawn(remote_source, first_hop, num_messages);
+    (*sink_listener)->receive(
+      [](ok_atom) {
+        // nop
+      }
+    );
+  }
+};
+
+#define FlowManySystemsPipeline(num)                                           \
+  BENCHMARK_TEMPLATE_F(FlowManySystems, FlowPipeline_##num, num)               \
+  (benchmark::State & state) {                                                 \
+    element_counters counters;                                                 \
+    for (auto _ : state)                                                       \
+      run();                                                                   \
+    counters.report(state, num_messages);                                      \
+  }
+
+FlowManySystemsPipeline(0)
+FlowManySystemsPipeline(1)
+FlowManySystemsPipeline(2)
+FlowManySystemsPipeline(3)
+FlowManySystemsPipeline(4)
+
+#endif // CAF_VERSION >= 1900
+
+BENCHMARK_MAIN();
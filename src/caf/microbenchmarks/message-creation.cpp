@@ -2,12 +2,16 @@
 #include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <string>
+#include <utility>
 
 #include <benchmark/benchmark.h>
 
 #include "caf/all.hpp"
 #include "caf/io/all.hpp"
 
+#include "benchmark_counters.hpp"
+
 using std::cerr;
 using std::cout;
 using std::endl;
@@ -26,22 +30,183 @@ struct MessageCreation : benchmark::Fixture {
 // -- benchmarking of message creation -----------------------------------------
 
 BENCHMARK_DEFINE_F(MessageCreation, NativeCreation)(benchmark::State& state) {
+  operation_counters counters;
   for (auto _ : state) {
     auto msg = make_message(size_t{0});
     benchmark::DoNotOptimize(msg);
   }
+  counters.report(state);
 }
 
 BENCHMARK_REGISTER_F(MessageCreation, NativeCreation);
 
 BENCHMARK_DEFINE_F(MessageCreation, DynamicCreation)(benchmark::State& state) {
+  operation_counters counters;
   for (auto _ : state) {
     message_builder mb;
     message msg = mb.append(size_t{0}).to_message();
     benchmark::DoNotOptimize(msg);
   }
+  counters.report(state);
 }
 
 BENCHMARK_REGISTER_F(MessageCreation, DynamicCreation);
 
+// -- benchmarking of message creation with mixed element types ----------------
+
+/// Returns the element at position `I` of a message with mixed types, cycling
+/// through integers, floating point numbers and (short) strings.
+template <size_t I>
+auto mixed_element() {
+  if constexpr (I % 4 == 0)
+    return int32_t{I};
+  else if constexpr (I % 4 == 1)
+    return double{I};
+  else if constexpr (I % 4 == 2)
+    return std::string{"abc"};
+  else
+    return uint64_t{I};
+}
+
+template <size_t... Is>
+message make_mixed_message(std::index_sequence<Is...>) {
+  return make_message(mixed_element<Is>()...);
+}
+
+template <size_t... Is>
+message build_mixed_message(std::index_sequence<Is...>) {
+  message_builder mb;
+  (mb.append(mixed_element<Is>()), ...);
+  return mb.to_message();
+}
+
+template <size_t N>
+void NativeCreationMixed(benchmark::State& state) {
+  operation_counters counters;
+  for (auto _ : state) {
+    auto msg = make_mixed_message(std::make_index_sequence<N>{});
+    benchmark::DoNotOptimize(msg);
+  }
+  counters.report(state);
+}
+
+template <size_t N>
+void DynamicCreationMixed(benchmark::State& state) {
+  operation_counters counters;
+  for (auto _ : state) {
+    auto msg = build_mixed_message(std::make_index_sequence<N>{});
+    benchmark::DoNotOptimize(msg);
+  }
+  counters.report(state);
+}
+
+#define MixedCreation(num)                                                     \
+  BENCHMARK_TEMPLATE(NativeCreationMixed, num);                                \
+  BENCHMARK_TEMPLATE(DynamicCreationMixed, num);
+
+MixedCreation(1)
+MixedCreation(2)
+MixedCreation(4)
+MixedCreation(8)
+MixedCreation(12)
+MixedCreation(16)
+
+// -- benchmarking of message creation with large payloads ---------------------
+
+#if CAF_VERSION >= 1800
+using byte_vector = byte_buffer;
+#else
+using byte_vector = std::vector<char>;
+#endif
+
+/// Payload sizes from 1 KB to 1 MB.
+void PayloadSettings(benchmark::internal::Benchmark* b) {
+  b->RangeMultiplier(4)->Range(1 << 10, 1 << 20);
+}
+
+template <class T>
+T make_payload(size_t size) {
+  return T(size, typename T::value_type{'x'});
+}
+
+/// Copies the payload into each message, i.e., the caller keeps its value.
+template <class T>
+void PayloadCopy(benchmark::State& state) {
+  auto payload = make_payload<T>(static_cast<size_t>(state.range(0)));
+  operation_counters counters;
+  for (auto _ : state) {
+    auto msg = make_message(payload);
+    benchmark::DoNotOptimize(msg);
+  }
+  counters.report(state);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+/// Moves the payload into each message. Moves it back out of the (unshared)
+/// message afterwards to avoid re-creating the payload in each iteration.
+template <class T>
+void PayloadMove(benchmark::State& state) {
+  auto payload = make_payload<T>(static_cast<size_t>(state.range(0)));
+  operation_counters counters;
+  for (auto _ : state) {
+    auto msg = make_message(std::move(payload));
+    benchmark::DoNotOptimize(msg);
+    payload = std::move(msg.get_mutable_as<T>(0));
+  }
+  counters.report(state);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(PayloadCopy, std::string)->Apply(PayloadSettings);
+BENCHMARK_TEMPLATE(PayloadMove, std::string)->Apply(PayloadSettings);
+BENCHMARK_TEMPLATE(PayloadCopy, byte_vector)->Apply(PayloadSettings);
+BENCHMARK_TEMPLATE(PayloadMove, byte_vector)->Apply(PayloadSettings);
+
+// -- benchmarking of copy-on-write --------------------------------------------
+
+// Each iteration passes a copy of a shared message to a handler, i.e., the
+// message has a reference count of two when the handler runs. A handler that
+// takes its argument by mutable reference forces CAF to detach the message by
+// copying all elements before invoking the handler.
+
+template <class T>
+void HandlerConstRef(benchmark::State& state) {
+  auto original = make_message(
+    make_payload<T>(static_cast<size_t>(state.range(0))));
+  behavior bhvr{
+    [](const T& x) { benchmark::DoNotOptimize(x.data()); },
+  };
+  operation_counters counters;
+  for (auto _ : state) {
+    auto msg = original;
+    bhvr(msg);
+  }
+  counters.report(state);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+template <class T>
+void HandlerMutableRef(benchmark::State& state) {
+  auto original = make_message(
+    make_payload<T>(static_cast<size_t>(state.range(0))));
+  behavior bhvr{
+    [](T& x) {
+      x[0] = typename T::value_type{'y'};
+      benchmark::DoNotOptimize(x.data());
+    },
+  };
+  operation_counters counters;
+  for (auto _ : state) {
+    auto msg = original;
+    bhvr(msg);
+  }
+  counters.report(state);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(HandlerConstRef, std::string)->Apply(PayloadSettings);
+BENCHMARK_TEMPLATE(HandlerMutableRef, std::string)->Apply(PayloadSettings);
+BENCHMARK_TEMPLATE(HandlerConstRef, byte_vector)->Apply(PayloadSettings);
+BENCHMARK_TEMPLATE(HandlerMutableRef, byte_vector)->Apply(PayloadSettings);
+
 BENCHMARK_MAIN();
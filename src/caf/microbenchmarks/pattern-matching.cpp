@@ -1,10 +1,21 @@
 #include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
 
 #include <benchmark/benchmark.h>
 
 #include "caf/all.hpp"
 #include "caf/io/all.hpp"
 
+#include "perf_counter.hpp"
+
 struct bar;
 struct foo;
 
@@ -138,4 +149,279 @@ BENCHMARK_DEFINE_F(Messages, MatchDynamic)(benchmark::State& state) {
 
 BENCHMARK_REGISTER_F(Messages, MatchDynamic);
 
+// -- dispatch scaling benchmark -----------------------------------------------
+
+// Generates behaviors with N handlers, where handler I takes three integers
+// and the type of each argument encodes three bits of I. Hence, all handlers
+// have the same arity but distinct signatures, similar to the handlers of a
+// protocol actor.
+
+using dispatch_types = std::tuple<int8_t, int16_t, int32_t, int64_t, uint8_t,
+                                  uint16_t, uint32_t, uint64_t>;
+
+constexpr size_t dispatch_arity = 3;
+
+template <size_t I, size_t Pos>
+using dispatch_arg_t
+  = std::tuple_element_t<(I >> (3 * Pos)) & 7, dispatch_types>;
+
+template <size_t I, size_t... Pos>
+auto make_dispatch_handler(std::index_sequence<Pos...>) {
+  return [](dispatch_arg_t<I, Pos>...) { s_invoked = I + 1; };
+}
+
+template <size_t I, size_t... Pos>
+message make_dispatch_input(std::index_sequence<Pos...>) {
+  return make_message(dispatch_arg_t<I, Pos>{}...);
+}
+
+template <size_t... Is>
+behavior make_dispatch_behavior(std::index_sequence<Is...>) {
+  return behavior{
+    make_dispatch_handler<Is>(std::make_index_sequence<dispatch_arity>{})...};
+}
+
+/// Selects the input message for the handler at the position `state.range(0)`
+/// (0 = first, 1 = middle, 2 = last, 3 = no matching handler) and sets the
+/// expected handler ID.
+template <size_t... Is>
+message select_dispatch_input(benchmark::State& state,
+                              std::index_sequence<Is...>,
+                              size_t& expected_handler_id) {
+  constexpr size_t n = sizeof...(Is);
+  std::vector<message> inputs{
+    make_dispatch_input<Is>(std::make_index_sequence<dispatch_arity>{})...};
+  switch (state.range(0)) {
+    case 0:
+      state.SetLabel("first");
+      expected_handler_id = 1;
+      return inputs.front();
+    case 1:
+      state.SetLabel("middle");
+      expected_handler_id = n / 2 + 1;
+      return inputs[n / 2];
+    case 2:
+      state.SetLabel("last");
+      expected_handler_id = n;
+      return inputs.back();
+    default:
+      state.SetLabel("unmatched");
+      expected_handler_id = 0;
+      return make_message(std::string{"unmatched"});
+  }
+}
+
+void DispatchSettings(benchmark::internal::Benchmark* b) {
+  b->DenseRange(0, 3);
+}
+
+template <size_t N>
+void LinearDispatch(benchmark::State& state) {
+  auto bhvr = make_dispatch_behavior(std::make_index_sequence<N>{});
+  size_t expected = 0;
+  auto msg = select_dispatch_input(state, std::make_index_sequence<N>{},
+                                   expected);
+  for (auto _ : state) {
+    s_invoked = 0;
+    bhvr(msg);
+    if (s_invoked != expected) {
+      state.SkipWithError("Wrong handler called!");
+      break;
+    }
+  }
+}
+
+#if CAF_VERSION >= 1800
+
+/// Dispatches messages by looking up their type-ID signature in a hash map
+/// that stores one single-handler behavior per signature.
+class indexed_behavior {
+public:
+  template <class F>
+  void add(type_id_list signature, F handler) {
+    index_.emplace(signature, behavior{std::move(handler)});
+  }
+
+  bool operator()(message& msg) {
+    auto i = index_.find(msg.types());
+    if (i == index_.end())
+      return false;
+    i->second(msg);
+    return true;
+  }
+
+private:
+  struct signature_hash {
+    size_t operator()(type_id_list xs) const noexcept {
+      size_t result = xs.size();
+      for (auto id : xs)
+        result = result * 31 + id;
+      return result;
+    }
+  };
+
+  std::unordered_map<type_id_list, behavior, signature_hash> index_;
+};
+
+template <size_t I, size_t... Pos>
+void add_dispatch_handler(indexed_behavior& bhvr,
+                          std::index_sequence<Pos...> pos) {
+  bhvr.add(make_type_id_list<dispatch_arg_t<I, Pos>...>(),
+           make_dispatch_handler<I>(pos));
+}
+
+template <size_t... Is>
+indexed_behavior make_indexed_dispatch_behavior(std::index_sequence<Is...>) {
+  indexed_behavior result;
+  (add_dispatch_handler<Is>(result,
+                            std::make_index_sequence<dispatch_arity>{}),
+   ...);
+  return result;
+}
+
+template <size_t N>
+void IndexedDispatch(benchmark::State& state) {
+  auto bhvr = make_indexed_dispatch_behavior(std::make_index_sequence<N>{});
+  size_t expected = 0;
+  auto msg = select_dispatch_input(state, std::make_index_sequence<N>{},
+                                   expected);
+  for (auto _ : state) {
+    s_invoked = 0;
+    bhvr(msg);
+    if (s_invoked != expected) {
+      state.SkipWithError("Wrong handler called!");
+      break;
+    }
+  }
+}
+
+#  define IndexedDispatchCase(num)                                             \
+    BENCHMARK_TEMPLATE(IndexedDispatch, num)->Apply(DispatchSettings);
+
+#else
+
+#  define IndexedDispatchCase(num)
+
+#endif // CAF_VERSION >= 1800
+
+#define DispatchCase(num)                                                      \
+  BENCHMARK_TEMPLATE(LinearDispatch, num)->Apply(DispatchSettings);            \
+  IndexedDispatchCase(num)
+
+DispatchCase(8)
+DispatchCase(32)
+DispatchCase(128)
+DispatchCase(512)
+
+// -- randomized matching benchmark --------------------------------------------
+
+// Matches a pool of messages against the dispatch behavior with 128 handlers.
+// Each message in the pool has its own memory and draws its shape either
+// round-robin (a predictable sequence) or at random from a seeded generator.
+// Optionally, each batch starts with cold data caches. Reports the branch
+// and cache misses per match if the kernel grants access to the performance
+// counters. The buffer for evicting the caches defaults to four times the
+// last-level cache. Setting CAF_BENCH_THRASH_MB overrides its size, e.g., for
+// shortening cold runs on CPUs with a very large last-level cache.
+
+constexpr size_t num_pool_shapes = 128;
+
+constexpr size_t pool_size = 4096;
+
+constexpr std::mt19937::result_type pool_seed = 4711;
+
+template <size_t I>
+message make_pool_message() {
+  return make_dispatch_input<I>(std::make_index_sequence<dispatch_arity>{});
+}
+
+template <size_t... Is>
+std::vector<message (*)()> make_pool_factories(std::index_sequence<Is...>) {
+  return {&make_pool_message<Is>...};
+}
+
+/// Returns the size of the buffer for evicting the data caches.
+size_t thrash_buffer_size() {
+  if (auto str = getenv("CAF_BENCH_THRASH_MB"))
+    if (auto mb = atoi(str); mb > 0)
+      return static_cast<size_t>(mb) * 1024 * 1024;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  if (auto llc = sysconf(_SC_LEVEL3_CACHE_SIZE); llc > 0)
+    return 4 * static_cast<size_t>(llc);
+#endif
+  // the kernel may not report the cache size, e.g., in virtual machines
+  return size_t{256} * 1024 * 1024;
+}
+
+/// Evicts the message pool and the behavior from the data caches by writing
+/// to each cache line of a buffer that exceeds the last-level cache.
+void thrash_caches() {
+  static std::vector<char> buf(thrash_buffer_size());
+  for (size_t i = 0; i < buf.size(); i += 64)
+    buf[i] += 1;
+  benchmark::ClobberMemory();
+}
+
+void RandomizedMatchSettings(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"random", "cold"});
+  for (int64_t cold = 0; cold <= 1; ++cold)
+    for (int64_t random = 0; random <= 1; ++random)
+      b->Args({random, cold});
+}
+
+void RandomizedMatch(benchmark::State& state) {
+  auto random = state.range(0) != 0;
+  auto cold = state.range(1) != 0;
+  auto bhvr = make_dispatch_behavior(
+    std::make_index_sequence<num_pool_shapes>{});
+  auto factories = make_pool_factories(
+    std::make_index_sequence<num_pool_shapes>{});
+  std::mt19937 rng{pool_seed};
+  std::uniform_int_distribution<size_t> dist{0, num_pool_shapes - 1};
+  std::vector<message> pool;
+  std::vector<size_t> expected;
+  pool.reserve(pool_size);
+  expected.reserve(pool_size);
+  for (size_t i = 0; i < pool_size; ++i) {
+    auto shape = random ? dist(rng) : i % num_pool_shapes;
+    pool.emplace_back(factories[shape]());
+    expected.emplace_back(shape + 1);
+  }
+  perf_counter branch_misses{perf_counter::branch_misses};
+  perf_counter cache_misses{perf_counter::cache_misses};
+  uint64_t total_branch_misses = 0;
+  uint64_t total_cache_misses = 0;
+  for (auto _ : state) {
+    if (cold) {
+      state.PauseTiming();
+      thrash_caches();
+      state.ResumeTiming();
+    }
+    branch_misses.start();
+    cache_misses.start();
+    for (size_t i = 0; i < pool_size; ++i) {
+      s_invoked = 0;
+      bhvr(pool[i]);
+      if (s_invoked != expected[i]) {
+        state.SkipWithError("Wrong handler called!");
+        break;
+      }
+    }
+    branch_misses.stop();
+    cache_misses.stop();
+    total_branch_misses += branch_misses.value();
+    total_cache_misses += cache_misses.value();
+  }
+  auto matches = state.iterations() * static_cast<int64_t>(pool_size);
+  state.SetItemsProcessed(matches);
+  if (branch_misses.valid() && matches > 0)
+    state.counters["branch_misses/match"]
+      = static_cast<double>(total_branch_misses) / matches;
+  if (cache_misses.valid() && matches > 0)
+    state.counters["cache_misses/match"]
+      = static_cast<double>(total_cache_misses) / matches;
+}
+
+BENCHMARK(RandomizedMatch)->Apply(RandomizedMatchSettings);
+
 BENCHMARK_MAIN();
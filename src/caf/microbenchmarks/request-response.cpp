@@ -0,0 +1,212 @@
+// Measures the round-trip cost of request/response messaging. Each benchmark
+// combines a server (dynamically typed or typed, replying immediately or via
+// a response promise that it delivers later) with a client that sends the
+// next request only after receiving the previous response, using either
+// `request(...).then`, `request(...).await` or a blocking `receive`.
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "caf/all.hpp"
+
+#include "benchmark_counters.hpp"
+
+#if CAF_VERSION < 1800
+
+using tick_atom = caf::atom_constant<caf::atom("tick")>;
+static constexpr tick_atom tick_atom_v = tick_atom::value;
+
+#else
+
+CAF_BEGIN_TYPE_ID_BLOCK(request_response, first_custom_type_id)
+
+  CAF_ADD_ATOM(request_response, tick_atom);
+
+CAF_END_TYPE_ID_BLOCK(request_response)
+
+#endif
+
+using namespace caf;
+
+// -- constants and global state -----------------------------------------------
+
+namespace {
+
+/// Number of sequential round trips per benchmark iteration.
+constexpr int32_t num_round_trips = 1000;
+
+} // namespace
+
+// -- servers ------------------------------------------------------------------
+
+#if CAF_VERSION >= 1800
+using calc_actor
+  = typed_actor<result<int32_t>(int32_t), result<void>(tick_atom)>;
+#else
+using calc_actor = typed_actor<replies_to<int32_t>::with<int32_t>,
+                               reacts_to<tick_atom>>;
+#endif
+
+behavior untyped_server() {
+  return {
+    [](int32_t x) { return x + 1; },
+    [](tick_atom) {
+      // nop
+    },
+  };
+}
+
+calc_actor::behavior_type typed_server() {
+  return {
+    [](int32_t x) { return x + 1; },
+    [](tick_atom) {
+      // nop
+    },
+  };
+}
+
+/// Collects requests and answers them in a later message, i.e., after
+/// processing a tick that the server sends to itself.
+struct promise_state {
+  std::vector<std::pair<typed_response_promise<int32_t>, int32_t>> pending;
+};
+
+template <class Self>
+auto make_promise(Self* self, int32_t x) {
+  auto rp = self->template make_response_promise<int32_t>();
+  if (self->state.pending.empty())
+    self->send(actor_cast<actor>(self), tick_atom_v);
+  self->state.pending.emplace_back(rp, x);
+  return rp;
+}
+
+template <class Self>
+void deliver_promises(Self* self) {
+  for (auto& x : self->state.pending)
+    x.first.deliver(x.second + 1);
+  self->state.pending.clear();
+}
+
+behavior untyped_promise_server(stateful_actor<promise_state>* self) {
+  return {
+    [=](int32_t x) { return make_promise(self, x); },
+    [=](tick_atom) { deliver_promises(self); },
+  };
+}
+
+calc_actor::behavior_type
+typed_promise_server(calc_actor::stateful_pointer<promise_state> self) {
+  return {
+    [=](int32_t x) { return make_promise(self, x); },
+    [=](tick_atom) { deliver_promises(self); },
+  };
+}
+
+enum class server_kind {
+  untyped,
+  typed,
+  untyped_promise,
+  typed_promise,
+};
+
+template <server_kind Kind>
+auto spawn_server(actor_system& sys) {
+  if constexpr (Kind == server_kind::untyped)
+    return sys.spawn(untyped_server);
+  else if constexpr (Kind == server_kind::typed)
+    return sys.spawn(typed_server);
+  else if constexpr (Kind == server_kind::untyped_promise)
+    return sys.spawn(untyped_promise_server);
+  else
+    return sys.spawn(typed_promise_server);
+}
+
+// -- clients ------------------------------------------------------------------
+
+enum class client_kind {
+  then,
+  await,
+  receive,
+};
+
+template <class Handle>
+void request_then(event_based_actor* self, Handle server, int32_t n) {
+  self->request(server, infinite, n).then([=](int32_t) {
+    if (n > 1)
+      request_then(self, server, n - 1);
+  });
+}
+
+template <class Handle>
+void request_await(event_based_actor* self, Handle server, int32_t n) {
+  self->request(server, infinite, n).await([=](int32_t) {
+    if (n > 1)
+      request_await(self, server, n - 1);
+  });
+}
+
+// -- benchmark fixture --------------------------------------------------------
+
+struct RequestResponse : benchmark::Fixture {
+  RequestResponse() {
+#if CAF_VERSION >= 1800
+    caf::init_global_meta_objects<caf::id_block::request_response>();
+    caf::core::init_global_meta_objects();
+#endif
+  }
+
+  template <server_kind Server, client_kind Client>
+  void run(benchmark::State& state) {
+    actor_system_config cfg;
+    actor_system sys{cfg};
+    auto server = spawn_server<Server>(sys);
+    scoped_actor self{sys};
+    element_counters counters;
+    for (auto _ : state) {
+      if constexpr (Client == client_kind::receive) {
+        for (int32_t i = 0; i < num_round_trips; ++i)
+          self->request(server, infinite, i)
+            .receive(
+              [](int32_t) {
+                // nop
+              },
+              [&](error&) { state.SkipWithError("request failed"); });
+      } else {
+        auto client = sys.spawn([server](event_based_actor* client) {
+          if constexpr (Client == client_kind::then)
+            request_then(client, server, num_round_trips);
+          else
+            request_await(client, server, num_round_trips);
+        });
+        self->wait_for(client);
+      }
+    }
+    counters.report(state, num_round_trips);
+    anon_send_exit(server, exit_reason::user_shutdown);
+  }
+};
+
+#define RoundTrip(server, client)                                              \
+  BENCHMARK_DEFINE_F(RequestResponse, server##_##client)                       \
+  (benchmark::State & state) {                                                 \
+    run<server_kind::server, client_kind::client>(state);                      \
+  }                                                                            \
+  BENCHMARK_REGISTER_F(RequestResponse, server##_##client);
+
+RoundTrip(untyped, then)
+RoundTrip(typed, then)
+RoundTrip(untyped, await)
+RoundTrip(typed, await)
+RoundTrip(untyped, receive)
+RoundTrip(typed, receive)
+RoundTrip(untyped_promise, then)
+RoundTrip(typed_promise, then)
+RoundTrip(untyped_promise, await)
+RoundTrip(typed_promise, await)
+RoundTrip(untyped_promise, receive)
+RoundTrip(typed_promise, receive)
+
+BENCHMARK_MAIN();
@@ -1,14 +1,644 @@
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 
 #include "caf/all.hpp"
 #include "caf/io/all.hpp"
 
+#if __has_include("caf/json_writer.hpp") && __has_include("caf/json_reader.hpp")
+#  include "caf/json_reader.hpp"
+#  include "caf/json_writer.hpp"
+#  define CAF_BENCH_HAS_JSON
+#endif
+
+#include "benchmark_counters.hpp"
+
 using namespace caf;
 
+// -- user-defined records -----------------------------------------------------
+
+/// A partial execution of an order.
+struct fill {
+  uint64_t price;
+  uint32_t quantity;
+};
+
+/// A nested record with strings, a list of sub-records and a map.
+struct order {
+  uint64_t id;
+  std::string symbol;
+  int32_t side;
+  std::vector<fill> fills;
+  std::map<std::string, std::string> tags;
+};
+
+#if CAF_VERSION >= 1800
+
+template <class Inspector>
+bool inspect(Inspector& f, fill& x) {
+  return f.object(x).fields(f.field("price", x.price),
+                            f.field("quantity", x.quantity));
+}
+
+template <class Inspector>
+bool inspect(Inspector& f, order& x) {
+  return f.object(x).fields(f.field("id", x.id), f.field("symbol", x.symbol),
+                            f.field("side", x.side),
+                            f.field("fills", x.fills), f.field("tags", x.tags));
+}
+
+#else
+
+template <class Inspector>
+typename Inspector::result_type inspect(Inspector& f, fill& x) {
+  return f(meta::type_name("fill"), x.price, x.quantity);
+}
+
+template <class Inspector>
+typename Inspector::result_type inspect(Inspector& f, order& x) {
+  return f(meta::type_name("order"), x.id, x.symbol, x.side, x.fills,
+           x.tags);
+}
+
+#endif
+
+// -- type families ------------------------------------------------------------
+
+using u64_vector = std::vector<uint64_t>;
+
+using nested_map = std::map<std::string, std::map<std::string, uint64_t>>;
+
+using order_vector = std::vector<order>;
+
+#if CAF_VERSION >= 1800
+
+using variant_vector = std::vector<std::variant<uint64_t, double, std::string>>;
+
+using optional_vector = std::vector<std::optional<uint64_t>>;
+
+#endif
+
+/// Creates a sample value of type `T`, where `n` scales the size of the value,
+/// e.g., the number of elements in a list.
+template <class T>
+struct sample;
+
+template <>
+struct sample<uint64_t> {
+  static uint64_t make(size_t) {
+    return 0xDEADBEEF;
+  }
+};
+
+template <>
+struct sample<double> {
+  static double make(size_t) {
+    return 3.14159;
+  }
+};
+
+template <>
+struct sample<u64_vector> {
+  static u64_vector make(size_t n) {
+    u64_vector result(n);
+    for (size_t i = 0; i < n; ++i)
+      result[i] = i * 7919;
+    return result;
+  }
+};
+
+template <>
+struct sample<std::string> {
+  static std::string make(size_t n) {
+    std::string result(n, ' ');
+    for (size_t i = 0; i < n; ++i)
+      result[i] = static_cast<char>('a' + i % 26);
+    return result;
+  }
+};
+
+template <>
+struct sample<nested_map> {
+  static nested_map make(size_t n) {
+    nested_map result;
+    for (size_t i = 0; i < n; ++i) {
+      auto& inner = result["section-" + std::to_string(i)];
+      for (size_t j = 0; j < 8; ++j)
+        inner["key-" + std::to_string(j)] = i * j;
+    }
+    return result;
+  }
+};
+
+template <>
+struct sample<order_vector> {
+  static order_vector make(size_t n) {
+    order_vector result;
+    for (size_t i = 0; i < n; ++i) {
+      order x{i, "SYM" + std::to_string(i % 100), i % 2 == 0 ? 1 : -1, {}, {}};
+      for (uint32_t j = 0; j < 4; ++j)
+        x.fills.push_back(fill{1000 + i + j, 10 * (j + 1)});
+      x.tags["venue"] = "XNAS";
+      x.tags["account"] = "acc-" + std::to_string(i % 16);
+      result.emplace_back(std::move(x));
+    }
+    return result;
+  }
+};
+
+#if CAF_VERSION >= 1800
+
+template <>
+struct sample<variant_vector> {
+  static variant_vector make(size_t n) {
+    variant_vector result;
+    for (size_t i = 0; i < n; ++i) {
+      switch (i % 3) {
+        case 0:
+          result.emplace_back(uint64_t{i});
+          break;
+        case 1:
+          result.emplace_back(i * 0.5);
+          break;
+        default:
+          result.emplace_back("value-" + std::to_string(i));
+      }
+    }
+    return result;
+  }
+};
+
+template <>
+struct sample<optional_vector> {
+  static optional_vector make(size_t n) {
+    optional_vector result;
+    for (size_t i = 0; i < n; ++i)
+      if (i % 2 == 0)
+        result.emplace_back(i);
+      else
+        result.emplace_back(std::nullopt);
+    return result;
+  }
+};
+
+#endif
+
+// -- utility functions --------------------------------------------------------
+
+/// Applies the inspector `f` to `x` and returns whether it succeeded.
+template <class Inspector, class T>
+bool apply(Inspector& f, T& x) {
+#if CAF_VERSION >= 1800
+  return f.apply(x);
+#else
+  return !f(x);
+#endif
+}
+
+template <class T>
+binary_serializer::container_type to_binary(T& x) {
+  binary_serializer::container_type buf;
+  binary_serializer sink{nullptr, buf};
+  if (!apply(sink, x))
+    std::cerr << "failed to serialize sample value" << std::endl;
+  return buf;
+}
+
+/// Reports the throughput in bytes/s for the encoded size of a value. Setting
+/// `payload_size` to the size of the binary encoding additionally reports
+/// `payload_bytes/s`, i.e., a throughput that compares across encodings.
+void report_encoded_size(benchmark::State& state, size_t encoded_size,
+                         size_t payload_size = 0) {
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()
+                                               * encoded_size));
+  state.counters["encoded_bytes"] = static_cast<double>(encoded_size);
+  if (payload_size > 0)
+    state.counters["payload_bytes/s"]
+      = benchmark::Counter(static_cast<double>(payload_size),
+                           benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// -- parameters for the type families -----------------------------------------
+
+void ScalarSettings(benchmark::internal::Benchmark* b) {
+  b->Arg(1);
+}
+
+/// Number of elements for flat lists and number of characters for strings.
+void SequenceSettings(benchmark::internal::Benchmark* b) {
+  b->RangeMultiplier(16)->Range(1, 1 << 20);
+}
+
+/// Number of records for nested types.
+void RecordSettings(benchmark::internal::Benchmark* b) {
+  b->RangeMultiplier(8)->Range(1, 1 << 12);
+}
+
+// -- benchmarks for the type families -----------------------------------------
+
+template <class T>
+void BinarySerialize(benchmark::State& state) {
+  auto x = sample<T>::make(static_cast<size_t>(state.range(0)));
+  size_t encoded_size = 0;
+  operation_counters counters;
+  for (auto _ : state) {
+    binary_serializer::container_type buf;
+    binary_serializer sink{nullptr, buf};
+    auto res = apply(sink, x);
+    static_cast<void>(res); // Discard.
+    encoded_size = buf.size();
+    benchmark::DoNotOptimize(buf);
+  }
+  counters.report(state);
+  report_encoded_size(state, encoded_size, encoded_size);
+}
+
+template <class T>
+void BinaryDeserialize(benchmark::State& state) {
+  auto x = sample<T>::make(static_cast<size_t>(state.range(0)));
+  auto buf = to_binary(x);
+  operation_counters counters;
+  for (auto _ : state) {
+    T result;
+    binary_deserializer source{nullptr, buf};
+    auto res = apply(source, result);
+    static_cast<void>(res); // Discard.
+    benchmark::DoNotOptimize(result);
+  }
+  counters.report(state);
+  report_encoded_size(state, buf.size(), buf.size());
+}
+
+/// Reuses one buffer for all iterations, i.e., serializes into memory that
+/// already has sufficient capacity after the first iteration.
+template <class T>
+void BinarySerializePooled(benchmark::State& state) {
+  auto x = sample<T>::make(static_cast<size_t>(state.range(0)));
+  binary_serializer::container_type buf;
+  operation_counters counters;
+  for (auto _ : state) {
+    buf.clear();
+    binary_serializer sink{nullptr, buf};
+    auto res = apply(sink, x);
+    static_cast<void>(res); // Discard.
+    benchmark::DoNotOptimize(buf);
+  }
+  counters.report(state);
+  report_encoded_size(state, buf.size(), buf.size());
+}
+
+/// Reuses one target for all iterations, i.e., lets the deserializer recycle
+/// the memory of the previous result where the inspector allows it.
+template <class T>
+void BinaryDeserializeInto(benchmark::State& state) {
+  auto x = sample<T>::make(static_cast<size_t>(state.range(0)));
+  auto buf = to_binary(x);
+  T result;
+  operation_counters counters;
+  for (auto _ : state) {
+    binary_deserializer source{nullptr, buf};
+    auto res = apply(source, result);
+    static_cast<void>(res); // Discard.
+    benchmark::DoNotOptimize(result);
+  }
+  counters.report(state);
+  report_encoded_size(state, buf.size(), buf.size());
+}
+
+// -- JSON encoding ------------------------------------------------------------
+
+#ifdef CAF_BENCH_HAS_JSON
+
+template <class T>
+void JsonSerialize(benchmark::State& state) {
+  auto x = sample<T>::make(static_cast<size_t>(state.range(0)));
+  size_t encoded_size = 0;
+  operation_counters counters;
+  for (auto _ : state) {
+    json_writer writer;
+    auto res = writer.apply(x);
+    static_cast<void>(res); // Discard.
+    encoded_size = writer.str().size();
+    benchmark::DoNotOptimize(writer);
+  }
+  counters.report(state);
+  report_encoded_size(state, encoded_size, to_binary(x).size());
+}
+
+template <class T>
+void JsonDeserialize(benchmark::State& state) {
+  auto x = sample<T>::make(static_cast<size_t>(state.range(0)));
+  json_writer writer;
+  if (!writer.apply(x))
+    std::cerr << "failed to serialize sample value" << std::endl;
+  std::string str{writer.str()};
+  operation_counters counters;
+  for (auto _ : state) {
+    T result;
+    json_reader reader;
+    auto res = reader.load(str) && reader.apply(result);
+    static_cast<void>(res); // Discard.
+    benchmark::DoNotOptimize(result);
+  }
+  counters.report(state);
+  report_encoded_size(state, str.size(), to_binary(x).size());
+}
+
+#  define JsonSerializationCase(type, settings)                                \
+    BENCHMARK_TEMPLATE(JsonSerialize, type)->Apply(settings);                  \
+    BENCHMARK_TEMPLATE(JsonDeserialize, type)->Apply(settings);
+
+#else
+
+#  define JsonSerializationCase(type, settings)
+
+#endif // CAF_BENCH_HAS_JSON
+
+// -- hand-rolled flat encoding ------------------------------------------------
+
+// The flat encoding bypasses the inspector API. It copies trivially copyable
+// data as-is (host byte order, including padding) and prefixes sequences with
+// their length. Decoding returns views into the buffer instead of copying
+// values out of it, i.e., it only checks bounds and records offsets. Hence,
+// the flat benchmarks show the lower bound for the cost per byte.
+
+/// A read-only view to an array of `T` in a flat buffer. Elements may be
+/// unaligned, so the view copies each element on access.
+template <class T>
+struct flat_array {
+  const char* data = nullptr;
+  size_t size = 0;
+
+  T operator[](size_t index) const {
+    T result;
+    memcpy(&result, data + index * sizeof(T), sizeof(T));
+    return result;
+  }
+};
+
+class flat_writer {
+public:
+  explicit flat_writer(std::vector<char>& buf) : buf_(buf) {
+    // nop
+  }
+
+  template <class T>
+  void write(const T& x) {
+    static_assert(std::is_trivially_copyable<T>::value);
+    write_bytes(&x, sizeof(T));
+  }
+
+  void write(std::string_view str) {
+    write(static_cast<uint32_t>(str.size()));
+    write_bytes(str.data(), str.size());
+  }
+
+  template <class T>
+  void write(const std::vector<T>& xs) {
+    static_assert(std::is_trivially_copyable<T>::value);
+    write(static_cast<uint32_t>(xs.size()));
+    write_bytes(xs.data(), xs.size() * sizeof(T));
+  }
+
+private:
+  void write_bytes(const void* data, size_t size) {
+    auto first = static_cast<const char*>(data);
+    buf_.insert(buf_.end(), first, first + size);
+  }
+
+  std::vector<char>& buf_;
+};
+
+class flat_reader {
+public:
+  explicit flat_reader(const std::vector<char>& buf)
+    : pos_(buf.data()), end_(buf.data() + buf.size()) {
+    // nop
+  }
+
+  template <class T>
+  bool read(T& x) {
+    static_assert(std::is_trivially_copyable<T>::value);
+    if (remaining() < sizeof(T))
+      return false;
+    memcpy(&x, pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  bool read(std::string_view& x) {
+    uint32_t size = 0;
+    if (!read(size) || remaining() < size)
+      return false;
+    x = std::string_view{pos_, size};
+    pos_ += size;
+    return true;
+  }
+
+  template <class T>
+  bool read(flat_array<T>& x) {
+    uint32_t size = 0;
+    if (!read(size) || remaining() < size * sizeof(T))
+      return false;
+    x.data = pos_;
+    x.size = size;
+    pos_ += size * sizeof(T);
+    return true;
+  }
+
+  const char* position() const {
+    return pos_;
+  }
+
+private:
+  size_t remaining() const {
+    return static_cast<size_t>(end_ - pos_);
+  }
+
+  const char* pos_;
+  const char* end_;
+};
+
+/// A decoded order that points into the flat buffer. The tags remain encoded
+/// as a sequence of key/value strings.
+struct order_view {
+  uint64_t id;
+  int32_t side;
+  std::string_view symbol;
+  flat_array<fill> fills;
+  uint32_t num_tags;
+  std::string_view tags;
+};
+
+/// Encodes values of type `T` to the flat format and decodes them into a
+/// `view_type`.
+template <class T>
+struct flat_codec {
+  static_assert(std::is_trivially_copyable<T>::value);
+
+  using view_type = T;
+
+  static void encode(flat_writer& sink, const T& x) {
+    sink.write(x);
+  }
+
+  static bool decode(flat_reader& source, view_type& x) {
+    return source.read(x);
+  }
+};
+
+template <>
+struct flat_codec<u64_vector> {
+  using view_type = flat_array<uint64_t>;
+
+  static void encode(flat_writer& sink, const u64_vector& xs) {
+    sink.write(xs);
+  }
+
+  static bool decode(flat_reader& source, view_type& x) {
+    return source.read(x);
+  }
+};
+
+template <>
+struct flat_codec<std::string> {
+  using view_type = std::string_view;
+
+  static void encode(flat_writer& sink, const std::string& str) {
+    sink.write(std::string_view{str});
+  }
+
+  static bool decode(flat_reader& source, view_type& x) {
+    return source.read(x);
+  }
+};
+
+template <>
+struct flat_codec<order_vector> {
+  using view_type = std::vector<order_view>;
+
+  static void encode(flat_writer& sink, const order_vector& xs) {
+    sink.write(static_cast<uint32_t>(xs.size()));
+    for (auto& x : xs) {
+      sink.write(x.id);
+      sink.write(x.side);
+      sink.write(std::string_view{x.symbol});
+      sink.write(x.fills);
+      sink.write(static_cast<uint32_t>(x.tags.size()));
+      for (auto& [key, val] : x.tags) {
+        sink.write(std::string_view{key});
+        sink.write(std::string_view{val});
+      }
+    }
+  }
+
+  static bool decode(flat_reader& source, view_type& xs) {
+    uint32_t size = 0;
+    if (!source.read(size))
+      return false;
+    xs.resize(size);
+    for (auto& x : xs) {
+      if (!source.read(x.id) || !source.read(x.side) || !source.read(x.symbol)
+          || !source.read(x.fills) || !source.read(x.num_tags))
+        return false;
+      // skip over the tags but keep a view to them
+      auto first = source.position();
+      std::string_view key;
+      std::string_view val;
+      for (uint32_t i = 0; i < x.num_tags; ++i)
+        if (!source.read(key) || !source.read(val))
+          return false;
+      x.tags = std::string_view{first, static_cast<size_t>(source.position()
+                                                           - first)};
+    }
+    return true;
+  }
+};
+
+template <class T>
+std::vector<char> to_flat(const T& x) {
+  std::vector<char> buf;
+  flat_writer sink{buf};
+  flat_codec<T>::encode(sink, x);
+  return buf;
+}
+
+template <class T>
+void FlatSerialize(benchmark::State& state) {
+  auto x = sample<T>::make(static_cast<size_t>(state.range(0)));
+  size_t encoded_size = 0;
+  operation_counters counters;
+  for (auto _ : state) {
+    std::vector<char> buf;
+    flat_writer sink{buf};
+    flat_codec<T>::encode(sink, x);
+    encoded_size = buf.size();
+    benchmark::DoNotOptimize(buf);
+  }
+  counters.report(state);
+  report_encoded_size(state, encoded_size, to_binary(x).size());
+}
+
+template <class T>
+void FlatDeserialize(benchmark::State& state) {
+  auto x = sample<T>::make(static_cast<size_t>(state.range(0)));
+  auto buf = to_flat(x);
+  operation_counters counters;
+  for (auto _ : state) {
+    typename flat_codec<T>::view_type result;
+    flat_reader source{buf};
+    auto res = flat_codec<T>::decode(source, result);
+    static_cast<void>(res); // Discard.
+    benchmark::DoNotOptimize(result);
+  }
+  counters.report(state);
+  report_encoded_size(state, buf.size(), to_binary(x).size());
+}
+
+#define FlatSerializationCase(type, settings)                                  \
+  BENCHMARK_TEMPLATE(FlatSerialize, type)->Apply(settings);                    \
+  BENCHMARK_TEMPLATE(FlatDeserialize, type)->Apply(settings);
+
+// -- registering all type families --------------------------------------------
+
+#define SerializationCase(type, settings)                                      \
+  BENCHMARK_TEMPLATE(BinarySerialize, type)->Apply(settings);                  \
+  BENCHMARK_TEMPLATE(BinaryDeserialize, type)->Apply(settings);                \
+  BENCHMARK_TEMPLATE(BinarySerializePooled, type)->Apply(settings);            \
+  BENCHMARK_TEMPLATE(BinaryDeserializeInto, type)->Apply(settings);            \
+  JsonSerializationCase(type, settings)
+
+SerializationCase(uint64_t, ScalarSettings)
+SerializationCase(double, ScalarSettings)
+SerializationCase(u64_vector, SequenceSettings)
+SerializationCase(std::string, SequenceSettings)
+SerializationCase(nested_map, RecordSettings)
+SerializationCase(order_vector, RecordSettings)
+
+#if CAF_VERSION >= 1800
+SerializationCase(variant_vector, RecordSettings)
+SerializationCase(optional_vector, RecordSettings)
+#endif
+
+// nested maps, variants and optionals have no trivially copyable parts
+FlatSerializationCase(uint64_t, ScalarSettings)
+FlatSerializationCase(double, ScalarSettings)
+FlatSerializationCase(u64_vector, SequenceSettings)
+FlatSerializationCase(std::string, SequenceSettings)
+FlatSerializationCase(order_vector, RecordSettings)
+
+// -- benchmarks for messages --------------------------------------------------
+
 template <class... Ts>
 config_value cfg_lst(Ts&&... xs) {
   config_value::list lst{config_value{std::forward<Ts>(xs)}...};
@@ -39,6 +669,7 @@ struct Messages : benchmark::Fixture {
 };
 
 BENCHMARK_DEFINE_F(Messages, BinarySerializer)(benchmark::State& state) {
+  operation_counters counters;
   for (auto _ : state) {
     binary_serializer::container_type buf;
     buf.reserve(512);
@@ -47,11 +678,29 @@ BENCHMARK_DEFINE_F(Messages, BinarySerializer)(benchmark::State& state) {
     static_cast<void>(res); // Discard.
     benchmark::DoNotOptimize(buf);
   }
+  counters.report(state);
 }
 
 BENCHMARK_REGISTER_F(Messages, BinarySerializer);
 
+BENCHMARK_DEFINE_F(Messages, BinarySerializerPooled)(benchmark::State& state) {
+  binary_serializer::container_type buf;
+  buf.reserve(512);
+  operation_counters counters;
+  for (auto _ : state) {
+    buf.clear();
+    binary_serializer sink{nullptr, buf};
+    auto res = inspect(sink, recursive);
+    static_cast<void>(res); // Discard.
+    benchmark::DoNotOptimize(buf);
+  }
+  counters.report(state);
+}
+
+BENCHMARK_REGISTER_F(Messages, BinarySerializerPooled);
+
 BENCHMARK_DEFINE_F(Messages, BinaryDeserializer)(benchmark::State& state) {
+  operation_counters counters;
   for (auto _ : state) {
     message result;
     binary_deserializer source{nullptr, binary_serialized};
@@ -59,8 +708,23 @@ BENCHMARK_DEFINE_F(Messages, BinaryDeserializer)(benchmark::State& state) {
     static_cast<void>(res); // Discard.
     benchmark::DoNotOptimize(result);
   }
+  counters.report(state);
 }
 
 BENCHMARK_REGISTER_F(Messages, BinaryDeserializer);
 
+BENCHMARK_DEFINE_F(Messages, BinaryDeserializerInto)(benchmark::State& state) {
+  message result;
+  operation_counters counters;
+  for (auto _ : state) {
+    binary_deserializer source{nullptr, binary_serialized};
+    auto res = inspect(source, result);
+    static_cast<void>(res); // Discard.
+    benchmark::DoNotOptimize(result);
+  }
+  counters.report(state);
+}
+
+BENCHMARK_REGISTER_F(Messages, BinaryDeserializerInto);
+
 BENCHMARK_MAIN();
@@ -1,22 +1,83 @@
 #include <vector>
 #include <chrono>
 #include <cstdint>
+#include <string>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <benchmark/benchmark.h>
 
 #include "caf/all.hpp"
 #include "caf/io/all.hpp"
 
+#include "benchmark_counters.hpp"
+#include "sample_stats.hpp"
+#include "tcp_relay.hpp"
+#include "thread_pinning.hpp"
+
+// -- element types ------------------------------------------------------------
+
+/// A text line, e.g., from a log file.
+struct log_record {
+  std::string text;
+};
+
+/// An opaque chunk of bytes, e.g., a block of a file.
+struct blob {
+  std::vector<char> data;
+};
+
 #ifdef CAF_BEGIN_TYPE_ID_BLOCK
 
 CAF_BEGIN_TYPE_ID_BLOCK(streaming, first_custom_type_id)
 
   CAF_ADD_TYPE_ID(streaming, (caf::stream<uint64_t>) );
   CAF_ADD_TYPE_ID(streaming, (std::vector<uint64_t>) );
+  CAF_ADD_TYPE_ID(streaming, (log_record) );
+  CAF_ADD_TYPE_ID(streaming, (blob) );
+  CAF_ADD_TYPE_ID(streaming, (caf::stream<log_record>) );
+  CAF_ADD_TYPE_ID(streaming, (caf::stream<std::vector<uint64_t>>) );
+  CAF_ADD_TYPE_ID(streaming, (caf::stream<blob>) );
+  CAF_ADD_TYPE_ID(streaming, (std::vector<log_record>) );
+  CAF_ADD_TYPE_ID(streaming, (std::vector<std::vector<uint64_t>>) );
+  CAF_ADD_TYPE_ID(streaming, (std::vector<blob>) );
 
 CAF_END_TYPE_ID_BLOCK(streaming)
 
+template <class Inspector>
+bool inspect(Inspector& f, log_record& x) {
+  return f.object(x).fields(f.field("text", x.text));
+}
+
+template <class Inspector>
+bool inspect(Inspector& f, blob& x) {
+  return f.object(x).fields(f.field("data", x.data));
+}
+
+#else
+
+template <class Inspector>
+typename Inspector::result_type inspect(Inspector& f, log_record& x) {
+  return f(caf::meta::type_name("log_record"), x.text);
+}
+
+template <class Inspector>
+typename Inspector::result_type inspect(Inspector& f, blob& x) {
+  return f(caf::meta::type_name("blob"), x.data);
+}
+
 #endif
 
 using std::vector;
@@ -29,8 +90,65 @@ namespace {
 
 constexpr size_t num_messages = 1'000'000;
 
+constexpr size_t num_tuning_messages = 100'000;
+
+constexpr size_t num_slow_messages = 10'000;
+
+constexpr size_t num_payload_messages = 10'000;
+
+int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
 } // namespace <anonymous>
 
+// -- creating and measuring elements ------------------------------------------
+
+template <class T>
+struct element_trait;
+
+template <>
+struct element_trait<uint64_t> {
+  static uint64_t make(size_t) {
+    return 42;
+  }
+  static size_t bytes(const uint64_t&) {
+    return sizeof(uint64_t);
+  }
+};
+
+template <>
+struct element_trait<log_record> {
+  static log_record make(size_t size) {
+    return {std::string(size, 'x')};
+  }
+  static size_t bytes(const log_record& x) {
+    return x.text.size();
+  }
+};
+
+template <>
+struct element_trait<vector<uint64_t>> {
+  static vector<uint64_t> make(size_t size) {
+    return vector<uint64_t>(std::max(size / sizeof(uint64_t), size_t{1}), 42);
+  }
+  static size_t bytes(const vector<uint64_t>& x) {
+    return x.size() * sizeof(uint64_t);
+  }
+};
+
+template <>
+struct element_trait<blob> {
+  static blob make(size_t size) {
+    return {vector<char>(size, 'x')};
+  }
+  static size_t bytes(const blob& x) {
+    return x.data.size();
+  }
+};
+
 // -- utility for running streaming benchmarks ---------------------------------
 
 void StreamingSettings(benchmark::internal::Benchmark* b) {
@@ -39,38 +157,143 @@ void StreamingSettings(benchmark::internal::Benchmark* b) {
       b->Args({i, j});
 }
 
-// -- simple integer source ----------------------------------------------------
+/// Sweeps pipeline depth, batch size, buffer capacity and credit round
+/// interval (in microseconds). CAF 0.17 has no settings for batch and buffer
+/// sizes, so it only sweeps depth and interval with a single placeholder
+/// batch and buffer size.
+void StreamTuningSettings(benchmark::internal::Benchmark* b) {
+#if CAF_VERSION >= 1800
+  auto batches = {10, 100, 1000};
+  auto buffers = {1000, 10000};
+#else
+  auto batches = {0};
+  auto buffers = {0};
+#endif
+  for (int depth : {0, 2, 4})
+    for (int batch : batches)
+      for (int buffer : buffers)
+        for (int interval_us : {1000, 10000})
+          b->Args({depth, batch, buffer, interval_us});
+}
+
+/// Sweeps the number of sources that feed into a single merge stage and the
+/// number of elements per source.
+void StreamMergeSettings(benchmark::internal::Benchmark* b) {
+  for (int i = 2; i <= 64; i *= 2)
+    for (int j = 100; j <= 100'000; j *= 10)
+      b->Args({i, j});
+}
+
+/// Sweeps element types (0 = uint64_t, 1 = log_record, 2 = vector<uint64_t>,
+/// 3 = blob) and element sizes in bytes.
+void StreamPayloadSettings(benchmark::internal::Benchmark* b) {
+  b->Args({0, 8});
+  b->Args({1, 32});
+  b->Args({1, 1024});
+  b->Args({2, 64});
+  b->Args({2, 8192});
+  b->Args({3, 65536});
+}
+
+/// Sweeps element sizes in bytes for multi-system payload benchmarks.
+void ManySystemsPayloadSettings(benchmark::internal::Benchmark* b) {
+  for (int size : {32, 1024, 8192, 65536})
+    b->Arg(size);
+}
+
+/// Sweeps the slowdown mode (0 = CPU work, 1 = sleep) and the slowdown per
+/// element (in microseconds) of a slow stage.
+void StreamSlowStageSettings(benchmark::internal::Benchmark* b) {
+  for (int mode : {0, 1})
+    for (int us : {0, 1, 10, 100})
+      b->Args({mode, us});
+}
+
+// -- simple source ------------------------------------------------------------
 
 struct source_state {
   const char* name = "source";
 };
 
+/// Streams `max_messages` copies of `proto` to `dest`.
+template <class T>
 void source(stateful_actor<source_state> *self, actor dest,
-            size_t max_messages) {
+            size_t max_messages, T proto) {
+  attach_stream_source(
+    self, dest,
+    // initialize state
+    [](size_t& n) { n = 0; },
+    // get next element
+    [=](size_t& n, downstream<T>& out, size_t hint) {
+      auto num = std::min(hint, max_messages - n);
+      for (size_t i = 0; i < num; ++i)
+        out.push(proto);
+      n += num;
+    },
+    // check whether we reached the end
+    [=](const size_t& n) { return n == max_messages; });
+}
+
+// -- source emitting timestamps -----------------------------------------------
+
+void timestamp_source(stateful_actor<source_state>* self, actor dest,
+                      size_t max_messages) {
+  attach_stream_source(
+    self, dest,
+    // initialize state
+    [](size_t& n) { n = 0; },
+    // get next element
+    [=](size_t& n, downstream<uint64_t>& out, size_t hint) {
+      auto num = std::min(hint, max_messages - n);
+      for (size_t i = 0; i < num; ++i)
+        out.push(static_cast<uint64_t>(now_ns()));
+      n += num;
+    },
+    // check whether we reached the end
+    [=](const size_t& n) { return n == max_messages; });
+}
+
+// -- source reporting backpressure --------------------------------------------
+
+/// Observes the downstream buffer of a source and how long the source waits
+/// for credit between two calls to its generator.
+struct source_probe {
+  size_t max_buffered = 0;
+  int64_t stall_ns = 0;
+  int64_t last_pull = 0;
+};
+
+void probing_source(stateful_actor<source_state>* self, actor dest,
+                    size_t max_messages, source_probe* probe) {
   attach_stream_source(
     self, dest,
     // initialize state
     [](size_t& n) { n = 0; },
     // get next element
     [=](size_t& n, downstream<uint64_t>& out, size_t hint) {
+      if (probe->last_pull != 0)
+        probe->stall_ns += now_ns() - probe->last_pull;
       auto num = std::min(hint, max_messages - n);
       for (size_t i = 0; i < num; ++i)
         out.push(i);
       n += num;
+      probe->max_buffered = std::max(probe->max_buffered, out.buf().size());
+      probe->last_pull = now_ns();
     },
     // check whether we reached the end
     [=](const size_t& n) { return n == max_messages; });
 }
 
-// -- simple integer stage -----------------------------------------------------
+// -- simple stage -------------------------------------------------------------
 
 struct stage_state {
   const char* name = "stage";
 };
 
+template <class T>
 behavior stage(stateful_actor<stage_state>* self) {
   return {
-    [=](stream<uint64_t> in) {
+    [=](stream<T> in) {
       return attach_stream_stage(
         self,
         // input stream
@@ -80,7 +303,7 @@ behavior stage(stateful_actor<stage_state>* self) {
           // nop
         },
         // processing step
-        [=](unit_t&, downstream<uint64_t>& xs, uint64_t x) { xs.push(x); },
+        [=](unit_t&, downstream<T>& xs, T x) { xs.push(std::move(x)); },
         // cleanup
         [=](unit_t&) {
           // nop
@@ -95,7 +318,8 @@ struct fork_state {
   const char* name = "fork";
 };
 
-behavior fork(stateful_actor<fork_state>* self, vector<actor> sinks) {
+// not named `fork` to avoid clashing with fork() from unistd.h
+behavior fork_stage(stateful_actor<fork_state>* self, vector<actor> sinks) {
   auto mgr = attach_continuous_stream_stage(
     self,
     // initialize state
@@ -119,12 +343,85 @@ behavior fork(stateful_actor<fork_state>* self, vector<actor> sinks) {
   };
 }
 
+// -- merge stage for fan-in ---------------------------------------------------
+
+struct merge_state {
+  const char* name = "merge";
+  size_t inputs = 0;
+};
+
+behavior merge_stage(stateful_actor<merge_state>* self, actor snk,
+                     size_t num_inputs) {
+  auto mgr = attach_continuous_stream_stage(
+    self,
+    // initialize state
+    [](unit_t&) {
+      // nop
+    },
+    // processing step
+    [=](unit_t&, downstream<uint64_t>& xs, uint64_t x) { xs.push(x); },
+    // cleanup
+    [=](unit_t&) {
+      // nop
+    });
+  mgr->add_outbound_path(snk);
+  return {
+    [=](stream<uint64_t> in) {
+      // shut down after the last input closes
+      if (++self->state.inputs == num_inputs)
+        mgr->continuous(false);
+      return mgr->add_inbound_path(in);
+    }
+  };
+}
+
+// -- stage that is slower than its producer -----------------------------------
+
+/// Spends `us` microseconds either computing (mode 0) or sleeping (mode 1).
+void slow_down(int64_t mode, int64_t us) {
+  if (us == 0)
+    return;
+  if (mode == 1) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+    return;
+  }
+  auto deadline = now_ns() + us * 1000;
+  while (now_ns() < deadline)
+    ; // busy wait
+}
+
+behavior slow_stage(stateful_actor<stage_state>* self, int64_t mode,
+                    int64_t us) {
+  return {
+    [=](stream<uint64_t> in) {
+      return attach_stream_stage(
+        self,
+        // input stream
+        in,
+        // initialize state
+        [](unit_t&) {
+          // nop
+        },
+        // processing step
+        [=](unit_t&, downstream<uint64_t>& xs, uint64_t x) {
+          slow_down(mode, us);
+          xs.push(x);
+        },
+        // cleanup
+        [=](unit_t&) {
+          // nop
+        });
+    },
+  };
+}
+
 // -- simple stage for building pipelines one-by-one ---------------------------
 
 struct continuous_stage_state {
   const char* name = "continuous_stage";
 };
 
+template <class T>
 behavior continuous_stage(stateful_actor<continuous_stage_state> *self,
                           actor next_hop) {
   auto mgr = attach_continuous_stream_stage(
@@ -134,28 +431,32 @@ behavior continuous_stage(stateful_actor<continuous_stage_state> *self,
       // nop
     },
     // processing step
-    [=](unit_t&, downstream<uint64_t>& xs, uint64_t x) { xs.push(x); },
+    [=](unit_t&, downstream<T>& xs, T x) { xs.push(std::move(x)); },
     // cleanup
     [=](unit_t&) {
       // nop
     });
   mgr->add_outbound_path(next_hop);
   return {
-    [=](const stream<uint64_t>& in) {
+    [=](const stream<T>& in) {
       mgr->add_inbound_path(in);
     }
   };
 }
 
-// -- simple integer sink ------------------------------------------------------
+// -- simple sink --------------------------------------------------------------
 
 struct sink_state {
   const char* name = "sink";
 };
 
-behavior sink(stateful_actor<sink_state>* self, actor done_listener) {
+/// Consumes all elements and notifies `done_listener` after every
+/// `expected` elements.
+template <class T>
+behavior sink(stateful_actor<sink_state>* self, actor done_listener,
+              size_t expected) {
   return {
-    [=](stream<uint64_t> in) {
+    [=](stream<T> in) {
       return attach_stream_sink(
         self,
         // input stream
@@ -163,8 +464,8 @@ behavior sink(stateful_actor<sink_state>* self, actor done_listener) {
         // initialize state
         [](size_t& count) { count = 0; },
         // processing step
-        [=](size_t& count, uint64_t) {
-          if (++count == num_messages) {
+        [=](size_t& count, T) {
+          if (++count == expected) {
             self->send(done_listener, ok_atom_v);
             count = 0;
           }
@@ -177,6 +478,52 @@ behavior sink(stateful_actor<sink_state>* self, actor done_listener) {
   };
 }
 
+// -- sink measuring end-to-end latency ----------------------------------------
+
+behavior latency_sink(stateful_actor<sink_state>* self, sample_set* latencies) {
+  return {
+    [=](stream<uint64_t> in) {
+      return attach_stream_sink(
+        self,
+        // input stream
+        in,
+        // initialize state
+        [](unit_t&) {
+          // nop
+        },
+        // processing step
+        [=](unit_t&, uint64_t x) {
+          latencies->add(now_ns() - static_cast<int64_t>(x));
+        },
+        // cleanup
+        [=](unit_t&) {
+          // nop
+        });
+    },
+  };
+}
+
+// -- utility for payload benchmarks -------------------------------------------
+
+/// Calls `run_once` for each iteration of `state`, which streams `elements`
+/// copies of `proto`, and reports throughput as well as the peak heap growth
+/// per run (in-flight memory).
+template <class T, class F>
+void measure_payload(benchmark::State& state, size_t elements, const T& proto,
+                     F run_once) {
+  element_counters counters;
+  int64_t max_growth = 0;
+  for (auto _ : state) {
+    alloc_counter::reset_peak();
+    auto live_before = alloc_counter::live_bytes.load();
+    run_once();
+    max_growth = std::max(max_growth,
+                          alloc_counter::peak_bytes.load() - live_before);
+  }
+  counters.report(state, elements, element_trait<T>::bytes(proto));
+  state.counters["peak_kb"] = static_cast<double>(max_growth) / 1024;
+}
+
 // -- fixture for single-system streaming --------------------------------------
 
 struct FixtureBase : benchmark::Fixture {
@@ -189,41 +536,146 @@ struct FixtureBase : benchmark::Fixture {
   }
 };
 
+/// Creates a new actor system for each run. Google benchmark constructs all
+/// fixtures during static initialization, i.e., also when running as a node
+/// of ManyProcesses, so the fixtures must not start any thread before SetUp.
 struct SingleSystem : FixtureBase {
-  actor_system_config cfg;
-  actor_system sys{cfg};
+  std::unique_ptr<actor_system_config> cfg;
+  std::unique_ptr<actor_system> sys;
+
+  void SetUp(const benchmark::State&) override {
+    cfg = std::make_unique<actor_system_config>();
+    sys = std::make_unique<actor_system>(*cfg);
+  }
+
+  void TearDown(const benchmark::State&) override {
+    sys.reset();
+    cfg.reset();
+  }
 };
 
 BENCHMARK_DEFINE_F(SingleSystem, StreamPipeline)(benchmark::State& state) {
+  element_counters counters;
   for (auto _ : state) {
     {
-      auto snk = sys.spawn(sink, actor{});
+      auto n = static_cast<size_t>(state.range(1));
+      auto snk = sys->spawn(sink<uint64_t>, actor{}, n);
       for (auto i = 0; i < state.range(0); ++i)
-        snk = snk * sys.spawn(stage);
-      sys.spawn(source, snk, static_cast<size_t>(state.range(1)));
+        snk = snk * sys->spawn(stage<uint64_t>);
+      sys->spawn(source<uint64_t>, snk, n, uint64_t{42});
     }
-    sys.await_all_actors_done();
+    sys->await_all_actors_done();
   }
+  counters.report(state, static_cast<uint64_t>(state.range(1)));
 }
 
 BENCHMARK_REGISTER_F(SingleSystem, StreamPipeline)
     ->Apply(StreamingSettings);
 
 BENCHMARK_DEFINE_F(SingleSystem, StreamFork)(benchmark::State& state) {
+  element_counters counters;
   for (auto _ : state) {
     {
       vector<actor> sinks;
+      auto n = static_cast<size_t>(state.range(1));
       for (auto i = 0; i < state.range(0); ++i)
-        sinks.emplace_back(sys.spawn(sink, actor{}));
-      sys.spawn(source, sys.spawn(fork, std::move(sinks)), num_messages);
+        sinks.emplace_back(sys->spawn(sink<uint64_t>, actor{}, n));
+      sys->spawn(source<uint64_t>, sys->spawn(fork_stage, std::move(sinks)),
+                 n, uint64_t{42});
     }
-    sys.await_all_actors_done();
+    sys->await_all_actors_done();
   }
+  counters.report(state,
+                  static_cast<uint64_t>(state.range(0) * state.range(1)));
 }
 
 BENCHMARK_REGISTER_F(SingleSystem, StreamFork)
     ->Apply(StreamingSettings);
 
+template <class T>
+void run_payload_pipeline(actor_system& sys, benchmark::State& state) {
+  auto proto = element_trait<T>::make(static_cast<size_t>(state.range(1)));
+  measure_payload(state, num_payload_messages, proto, [&] {
+    {
+      auto snk = sys.spawn(sink<T>, actor{}, num_payload_messages)
+                 * sys.spawn(stage<T>);
+      sys.spawn(source<T>, snk, num_payload_messages, proto);
+    }
+    sys.await_all_actors_done();
+  });
+}
+
+BENCHMARK_DEFINE_F(SingleSystem, StreamPayload)(benchmark::State& state) {
+  switch (state.range(0)) {
+    case 0:
+      run_payload_pipeline<uint64_t>(*sys, state);
+      break;
+    case 1:
+      run_payload_pipeline<log_record>(*sys, state);
+      break;
+    case 2:
+      run_payload_pipeline<vector<uint64_t>>(*sys, state);
+      break;
+    default:
+      run_payload_pipeline<blob>(*sys, state);
+  }
+}
+
+BENCHMARK_REGISTER_F(SingleSystem, StreamPayload)
+    ->ArgNames({"type", "bytes"})
+    ->Apply(StreamPayloadSettings);
+
+BENCHMARK_DEFINE_F(SingleSystem, StreamMerge)(benchmark::State& state) {
+  element_counters counters;
+  auto num_sources = static_cast<size_t>(state.range(0));
+  auto per_source = static_cast<size_t>(state.range(1));
+  for (auto _ : state) {
+    {
+      auto snk = sys->spawn(sink<uint64_t>, actor{}, num_sources * per_source);
+      auto merge = sys->spawn(merge_stage, snk, num_sources);
+      for (size_t i = 0; i < num_sources; ++i)
+        sys->spawn(source<uint64_t>, merge, per_source, uint64_t{42});
+    }
+    sys->await_all_actors_done();
+  }
+  counters.report(state, num_sources * per_source);
+}
+
+BENCHMARK_REGISTER_F(SingleSystem, StreamMerge)
+    ->ArgNames({"sources", "elements"})
+    ->Apply(StreamMergeSettings);
+
+BENCHMARK_DEFINE_F(SingleSystem, StreamSlowStage)(benchmark::State& state) {
+  element_counters counters;
+  auto mode = state.range(0);
+  auto us = state.range(1);
+  source_probe probe;
+  int64_t max_growth = 0;
+  for (auto _ : state) {
+    probe.last_pull = 0;
+    alloc_counter::reset_peak();
+    auto live_before = alloc_counter::live_bytes.load();
+    {
+      auto snk = sys->spawn(sink<uint64_t>, actor{}, num_slow_messages)
+                 * sys->spawn(slow_stage, mode, us);
+      sys->spawn(probing_source, snk, num_slow_messages, &probe);
+    }
+    sys->await_all_actors_done();
+    max_growth = std::max(max_growth,
+                          alloc_counter::peak_bytes.load() - live_before);
+  }
+  counters.report(state, num_slow_messages);
+  // buffer occupancy and memory must stay bounded if backpressure works
+  state.counters["max_buffered"] = static_cast<double>(probe.max_buffered);
+  state.counters["peak_kb"] = static_cast<double>(max_growth) / 1024;
+  state.counters["stall_ms"]
+    = static_cast<double>(probe.stall_ns) / 1e6 / state.iterations();
+}
+
+BENCHMARK_REGISTER_F(SingleSystem, StreamSlowStage)
+    ->ArgNames({"sleep", "us"})
+    ->Apply(StreamSlowStageSettings);
+
 BENCHMARK_DEFINE_F(SingleSystem, MessagePipeline)(benchmark::State& state) {
   auto sender = [](event_based_actor* self, actor snk) {
     for (uint64_t i = 0; i < num_messages; ++i)
@@ -243,97 +695,206 @@ BENCHMARK_DEFINE_F(SingleSystem, MessagePipeline)(benchmark::State& state) {
       }
     };
   };
+  element_counters counters;
   for (auto _ : state) {
     {
-      auto snk = sys.spawn(receiver);
+      auto snk = sys->spawn(receiver);
       for (auto i = 0; i < state.range(0); ++i)
-        snk = sys.spawn(relay, snk);
-      sys.spawn(sender, snk);
+        snk = sys->spawn(relay, snk);
+      sys->spawn(sender, snk);
     }
-    sys.await_all_actors_done();
+    sys->await_all_actors_done();
   }
+  counters.report(state, num_messages);
 }
 
 BENCHMARK_REGISTER_F(SingleSystem, MessagePipeline)
     ->Apply(StreamingSettings);
 
+// -- sweep over stream parameters ---------------------------------------------
+
+struct tuning_config : actor_system_config {
+  tuning_config(int64_t batch_size, int64_t buffer_size, int64_t interval_us) {
+    auto interval = timespan{interval_us * 1000};
+#if CAF_VERSION >= 1800
+    // CAF 0.18 emits credit whenever a batch completes or times out, i.e.,
+    // the max. batch delay takes the role of the credit round interval
+    set("caf.stream.credit-policy", "token-based");
+    set("caf.stream.token-based-policy.batch-size", batch_size);
+    set("caf.stream.token-based-policy.buffer-size", buffer_size);
+    set("caf.stream.max-batch-delay", interval);
+#else
+    // CAF 0.17 sizes batches by complexity (time) instead of element counts
+    static_cast<void>(batch_size);
+    static_cast<void>(buffer_size);
+    stream_credit_round_interval = interval;
+    stream_max_batch_delay = interval;
+#endif
+  }
+};
+
+BENCHMARK_DEFINE_F(FixtureBase, StreamTuning)(benchmark::State& state) {
+  tuning_config cfg{state.range(1), state.range(2), state.range(3)};
+  actor_system sys{cfg};
+  sample_set latencies;
+  latencies.reserve(num_tuning_messages);
+  element_counters counters;
+  for (auto _ : state) {
+    {
+      auto snk = sys.spawn(latency_sink, &latencies);
+      for (auto i = 0; i < state.range(0); ++i)
+        snk = snk * sys.spawn(stage<uint64_t>);
+      sys.spawn(timestamp_source, snk, num_tuning_messages);
+    }
+    sys.await_all_actors_done();
+  }
+  counters.report(state, num_tuning_messages);
+  state.counters["p50_us"] = latencies.percentile(50) / 1e3;
+  state.counters["p99_us"] = latencies.percentile(99) / 1e3;
+}
+
+BENCHMARK_REGISTER_F(FixtureBase, StreamTuning)
+    ->ArgNames({"depth", "batch", "buffer", "interval_us"})
+    ->Apply(StreamTuningSettings);
+
 // -- fixture for multi-system streaming ---------------------------------------
 
-template <size_t NumStages>
-struct ManySystems : FixtureBase {
-  struct config : actor_system_config {
-    config() {
-      load<io::middleman>();
+/// Configuration for all systems that stream across the network.
+struct node_config : actor_system_config {
+  node_config() {
+    load<io::middleman>();
 #ifndef CAF_BEGIN_TYPE_ID_BLOCK
-      add_message_type_impl<stream<uint64_t>>("stream<uint64_t>");
-      add_message_type_impl<vector<uint64_t>>("vector<uint64_t>");
+    add_message_type_impl<stream<uint64_t>>("stream<uint64_t>");
+    add_message_type_impl<vector<uint64_t>>("vector<uint64_t>");
+    add_message_type<log_record>("log_record");
+    add_message_type<blob>("blob");
+    add_message_type_impl<stream<log_record>>("stream<log_record>");
+    add_message_type_impl<stream<vector<uint64_t>>>(
+      "stream<vector<uint64_t>>");
+    add_message_type_impl<stream<blob>>("stream<blob>");
+    add_message_type_impl<vector<log_record>>("vector<log_record>");
+    add_message_type_impl<vector<vector<uint64_t>>>(
+      "vector<vector<uint64_t>>");
+    add_message_type_impl<vector<blob>>("vector<blob>");
 #endif
-    }
-  };
+  }
+};
+
+/// Setting the environment variable CAF_BENCH_SHAPE to a shaping spec (see
+/// tcp_relay.hpp) routes all connections between the systems through a relay
+/// that adds delay, jitter and a bandwidth cap, e.g.,
+/// `CAF_BENCH_SHAPE=delay=100us,rate=10gbit`.
+template <size_t NumStages, class T = uint64_t>
+struct ManySystems : FixtureBase {
+  using config = node_config;
+
+  /// Number of elements that each run streams from source to sink.
+  static constexpr size_t elements_per_run
+    = std::is_same<T, uint64_t>::value ? num_messages : num_payload_messages;
 
   struct node {
     config cfg;
     actor_system sys{cfg};
     actor hdl;
-    uint16_t port;
+    uint16_t port = 0;
   };
 
   actor first_hop;
 
+  std::unique_ptr<tcp_relay_set> relays;
+
   static constexpr size_t num_nodes = NumStages + 2;
 
   static constexpr size_t source_node_id = 0;
 
   static constexpr size_t sink_node_id = NumStages + 1;
 
-  std::array<node, num_nodes> nodes;
+  /// Created in SetUp for the same reason as the system of SingleSystem.
+  std::array<std::unique_ptr<node>, num_nodes> nodes;
 
-  scoped_actor sink_listener;
+  std::unique_ptr<scoped_actor> sink_listener;
 
-  template <class T>
-  T unbox(expected<T> x) {
+  template <class U>
+  U unbox(expected<U> x) {
     if (!x)
       throw std::runtime_error("unbox failed");
     return std::move(*x);
   }
 
-  ManySystems() : sink_listener{nodes.back().sys} {
+  /// Returns the port for connecting to `port`, i.e., either `port` itself or
+  /// the port of a shaping relay in front of it.
+  uint16_t route(uint16_t port) {
+    if (!relays)
+      return port;
+    auto result = relays->add("127.0.0.1", port);
+    if (result == 0)
+      throw std::runtime_error("cannot start relay");
+    return result;
+  }
+
+  void SetUp(const benchmark::State&) override {
+    if (auto spec = getenv("CAF_BENCH_SHAPE")) {
+      shaping cfg;
+      if (!parse_shaping(spec, cfg))
+        throw std::runtime_error("invalid CAF_BENCH_SHAPE");
+      relays = std::make_unique<tcp_relay_set>(cfg);
+    }
+    for (auto& x : nodes)
+      x = std::make_unique<node>();
     uint16_t first_hop_port = 0;
-    auto& sink_node = nodes.back();
-    sink_node.hdl = sink_node.sys.spawn(sink, sink_listener);
-    sink_node.port = unbox(sink_node.sys.middleman().publish(sink_node.hdl, 0u));
+    auto& sink_node = *nodes.back();
+    sink_listener = std::make_unique<scoped_actor>(sink_node.sys);
+    sink_node.hdl = sink_node.sys.spawn(sink<T>, actor{*sink_listener},
+                                        elements_per_run);
+    sink_node.port = unbox(
+      sink_node.sys.middleman().publish(sink_node.hdl, 0u));
     for (size_t i = NumStages; i > 0; --i) {
-      auto& x = nodes[i];
-      auto next_hop = unbox(x.sys.middleman().remote_actor("127.0.0.1",
-                                                           nodes[i + 1].port));
-      x.hdl = x.sys.spawn(continuous_stage, next_hop);
+      auto& x = *nodes[i];
+      auto next_hop = unbox(x.sys.middleman().remote_actor(
+        "127.0.0.1", route(nodes[i + 1]->port)));
+      x.hdl = x.sys.spawn(continuous_stage<T>, next_hop);
       x.port = unbox(x.sys.middleman().publish(x.hdl, 0u));
     }
-    first_hop_port = nodes[1].port;
-    first_hop = unbox(nodes[0].sys.middleman().remote_actor("127.0.0.1",
-                                                            first_hop_port));
+    first_hop_port = route(nodes[1]->port);
+    first_hop = unbox(nodes[0]->sys.middleman().remote_actor("127.0.0.1",
+                                                             first_hop_port));
   }
 
-  ~ManySystems() {
+  void TearDown(const benchmark::State&) override {
+    first_hop = nullptr;
+    sink_listener.reset();
+    for (auto& x : nodes)
+      if (x)
+        anon_send_exit(x->hdl, exit_reason::user_shutdown);
+    // shut down the systems before the relays between them
     for (auto& x : nodes)
-      anon_send_exit(x.hdl, exit_reason::user_shutdown);
+      x.reset();
+    relays.reset();
   }
 
-  void run() {
-    nodes.front().sys.spawn(source, first_hop, num_messages);
-    sink_listener->receive(
+  void run(T proto = T{}) {
+    nodes.front()->sys.spawn(source<T>, first_hop, elements_per_run, proto);
+    (*sink_listener)->receive(
       [](ok_atom) {
         // nop
       }
     );
   }
+
+  /// Streams elements of `state.range(0)` bytes per run.
+  void run_payload(benchmark::State& state) {
+    auto proto = element_trait<T>::make(static_cast<size_t>(state.range(0)));
+    measure_payload(state, elements_per_run, proto, [&] { run(proto); });
+  }
 };
 
 #define ManySystemsStreamPipeline(num)                                         \
   BENCHMARK_TEMPLATE_F(ManySystems, StreamPipeline_##num, num)                 \
   (benchmark::State & state) {                                                 \
+    element_counters counters;                                                 \
     for (auto _ : state)                                                       \
       run();                                                                   \
+    counters.report(state, num_messages);                                      \
   }
 
 ManySystemsStreamPipeline(0)
@@ -342,4 +903,301 @@ ManySystemsStreamPipeline(2)
 ManySystemsStreamPipeline(3)
 ManySystemsStreamPipeline(4)
 
-BENCHMARK_MAIN();
+#define ManySystemsPayloadPipeline(name, type)                                 \
+  BENCHMARK_TEMPLATE2_DEFINE_F(ManySystems, StreamPayload_##name, 1, type)     \
+  (benchmark::State & state) {                                                 \
+    run_payload(state);                                                        \
+  }                                                                            \
+  BENCHMARK_REGISTER_F(ManySystems, StreamPayload_##name)                      \
+    ->ArgName("bytes")                                                         \
+    ->Apply(ManySystemsPayloadSettings);
+
+ManySystemsPayloadPipeline(log_record, log_record)
+ManySystemsPayloadPipeline(vector, std::vector<uint64_t>)
+ManySystemsPayloadPipeline(blob, blob)
+
+// -- fixture for multi-process streaming --------------------------------------
+
+// ManySystems runs all nodes in one process, i.e., the nodes share the heap,
+// the CPUs and the address space. ManyProcesses runs each node in a process
+// of its own. The fixture re-executes this binary once per node with
+// CAF_BENCH_STREAM_NODE=ROLE:INDEX:FD in the environment, where FD is the
+// child end of a control socket. Over this socket, the parent passes the port
+// of the next hop to each node, each node reports its own port, the parent
+// starts a run by sending 'r' to the source and the sink reports the end of
+// a run by sending 'd'. Closing the socket shuts the node down.
+//
+// Setting CAF_BENCH_NODE_CPUS=N pins node i to the CPUs [i * N, (i + 1) * N)
+// of the CPUs available to the benchmark and limits its scheduler to N
+// workers. ManyProcesses honors CAF_BENCH_SHAPE the same way as ManySystems.
+
+namespace {
+
+constexpr const char* node_env_var = "CAF_BENCH_STREAM_NODE";
+
+bool write_all(int fd, const void* buf, size_t len) {
+  auto bytes = static_cast<const char*>(buf);
+  while (len > 0) {
+    auto res = ::write(fd, bytes, len);
+    if (res <= 0)
+      return false;
+    bytes += res;
+    len -= static_cast<size_t>(res);
+  }
+  return true;
+}
+
+bool read_all(int fd, void* buf, size_t len) {
+  auto bytes = static_cast<char*>(buf);
+  while (len > 0) {
+    auto res = ::read(fd, bytes, len);
+    if (res <= 0)
+      return false;
+    bytes += res;
+    len -= static_cast<size_t>(res);
+  }
+  return true;
+}
+
+template <class T>
+void send_ctl(int fd, const T& x) {
+  if (!write_all(fd, &x, sizeof(T)))
+    throw std::runtime_error("cannot write to control socket");
+}
+
+template <class T>
+T receive_ctl(int fd) {
+  T result;
+  if (!read_all(fd, &result, sizeof(T)))
+    throw std::runtime_error("cannot read from control socket");
+  return result;
+}
+
+/// Returns the value of CAF_BENCH_NODE_CPUS or 0 if not set.
+size_t cpus_per_node() {
+  if (auto str = getenv("CAF_BENCH_NODE_CPUS"))
+    return static_cast<size_t>(std::max(atoi(str), 0));
+  return 0;
+}
+
+/// Pins the calling process to the CPU set of node `index`. Must run before
+/// starting any thread, since new threads inherit the affinity.
+bool pin_node(size_t index, size_t num_cpus) {
+  auto cpus = cpu_order(pinning_policy::compact, read_topology());
+  if (cpus.size() < num_cpus) {
+    std::cerr << "not enough CPUs for CAF_BENCH_NODE_CPUS=" << num_cpus
+              << std::endl;
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (size_t i = 0; i < num_cpus; ++i)
+    CPU_SET(cpus[(index * num_cpus + i) % cpus.size()], &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+/// Notifies the parent process via `ctl` whenever the sink is done.
+behavior done_notifier(event_based_actor*, int ctl) {
+  return {
+    [=](ok_atom) { send_ctl(ctl, 'd'); },
+  };
+}
+
+/// Runs a single node of a ManyProcesses pipeline in this process.
+int run_stream_node(const char* spec) {
+  char role[16];
+  size_t index = 0;
+  int ctl = -1;
+  if (sscanf(spec, "%15[a-z]:%zu:%d", role, &index, &ctl) != 3) {
+    std::cerr << "invalid " << node_env_var << ": " << spec << std::endl;
+    return EXIT_FAILURE;
+  }
+  node_config cfg;
+  if (auto num_cpus = cpus_per_node(); num_cpus > 0) {
+    if (!pin_node(index, num_cpus))
+      return EXIT_FAILURE;
+#if CAF_VERSION >= 1800
+    cfg.set("caf.scheduler.max-threads", num_cpus);
+#else
+    cfg.set("scheduler.max-threads", num_cpus);
+#endif
+  }
+  actor_system sys{cfg};
+  auto& mm = sys.middleman();
+  auto connect = [&](uint16_t port) {
+    auto hdl = mm.remote_actor("127.0.0.1", port);
+    if (!hdl)
+      throw std::runtime_error("cannot connect to next hop");
+    return std::move(*hdl);
+  };
+  auto publish = [&](const actor& hdl) {
+    auto port = mm.publish(hdl, 0u);
+    if (!port)
+      throw std::runtime_error("cannot publish actor");
+    send_ctl(ctl, *port);
+  };
+  vector<actor> hdls;
+  if (strcmp(role, "sink") == 0) {
+    auto notifier = sys.spawn(done_notifier, ctl);
+    hdls.emplace_back(sys.spawn(sink<uint64_t>, notifier, num_messages));
+    hdls.emplace_back(notifier);
+    publish(hdls.front());
+  } else if (strcmp(role, "stage") == 0) {
+    auto next_hop = connect(receive_ctl<uint16_t>(ctl));
+    hdls.emplace_back(sys.spawn(continuous_stage<uint64_t>, next_hop));
+    publish(hdls.front());
+  } else if (strcmp(role, "source") == 0) {
+    auto first_hop = connect(receive_ctl<uint16_t>(ctl));
+    send_ctl(ctl, uint16_t{0});
+    char cmd;
+    while (read_all(ctl, &cmd, 1) && cmd == 'r')
+      sys.spawn(source<uint64_t>, first_hop, num_messages, uint64_t{42});
+    return EXIT_SUCCESS;
+  } else {
+    std::cerr << "invalid role: " << role << std::endl;
+    return EXIT_FAILURE;
+  }
+  // block until the parent closes the control socket
+  char cmd;
+  while (read_all(ctl, &cmd, 1))
+    ; // nop
+  for (auto& hdl : hdls)
+    anon_send_exit(hdl, exit_reason::user_shutdown);
+  return EXIT_SUCCESS;
+}
+
+} // namespace <anonymous>
+
+template <size_t NumStages>
+struct ManyProcesses : FixtureBase {
+  struct node_process {
+    pid_t pid;
+    int ctl;
+  };
+
+  static constexpr size_t num_nodes = NumStages + 2;
+
+  std::vector<node_process> procs;
+
+  std::unique_ptr<tcp_relay_set> relays;
+
+  uint16_t route(uint16_t port) {
+    if (!relays)
+      return port;
+    auto result = relays->add("127.0.0.1", port);
+    if (result == 0)
+      throw std::runtime_error("cannot start relay");
+    return result;
+  }
+
+  /// Starts a new process for node `index` in the given role.
+  node_process spawn_node(const char* role, size_t index) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+      throw std::runtime_error("cannot create control socket");
+    // prepare everything for execve before forking, since the child may only
+    // call async-signal-safe functions in a multi-threaded parent
+    auto env_entry = std::string{node_env_var} + '=' + role + ':'
+                     + std::to_string(index) + ':' + std::to_string(fds[1]);
+    std::vector<char*> envp;
+    for (auto xs = environ; *xs != nullptr; ++xs)
+      envp.push_back(*xs);
+    envp.push_back(env_entry.data());
+    envp.push_back(nullptr);
+    char exe[] = "/proc/self/exe";
+    char* argv[] = {exe, nullptr};
+    auto pid = fork();
+    if (pid < 0)
+      throw std::runtime_error("cannot fork");
+    if (pid == 0) {
+      fcntl(fds[1], F_SETFD, 0);
+      execve(exe, argv, envp.data());
+      _exit(EXIT_FAILURE);
+    }
+    close(fds[1]);
+    return {pid, fds[0]};
+  }
+
+  void launch() {
+    if (auto spec = getenv("CAF_BENCH_SHAPE")) {
+      shaping cfg;
+      if (!parse_shaping(spec, cfg))
+        throw std::runtime_error("invalid CAF_BENCH_SHAPE");
+      relays = std::make_unique<tcp_relay_set>(cfg);
+    }
+    procs.resize(num_nodes);
+    procs.back() = spawn_node("sink", num_nodes - 1);
+    auto next_port = receive_ctl<uint16_t>(procs.back().ctl);
+    for (size_t i = NumStages; i > 0; --i) {
+      procs[i] = spawn_node("stage", i);
+      send_ctl(procs[i].ctl, route(next_port));
+      next_port = receive_ctl<uint16_t>(procs[i].ctl);
+    }
+    procs.front() = spawn_node("source", 0);
+    send_ctl(procs.front().ctl, route(next_port));
+    receive_ctl<uint16_t>(procs.front().ctl);
+  }
+
+  /// Closes the control sockets, which shuts down the nodes, and waits for
+  /// all nodes to terminate before stopping the relays between them.
+  void shutdown() {
+    for (auto& x : procs)
+      close(x.ctl);
+    for (auto& x : procs) {
+      int status = 0;
+      waitpid(x.pid, &status, 0);
+    }
+    procs.clear();
+    relays.reset();
+  }
+
+  // google benchmark registers all fixtures during static initialization,
+  // including in the node processes, so we launch in SetUp and shut down in
+  // TearDown to keep idle nodes from running alongside other benchmarks
+  void SetUp(const benchmark::State&) override {
+    launch();
+  }
+
+  void TearDown(const benchmark::State&) override {
+    shutdown();
+  }
+
+  ~ManyProcesses() {
+    shutdown();
+  }
+
+  void run() {
+    send_ctl(procs.front().ctl, 'r');
+    if (receive_ctl<char>(procs.back().ctl) != 'd')
+      throw std::runtime_error("unexpected message from sink");
+  }
+};
+
+// Reports elements/s only: all allocations happen in the node processes, so
+// element_counters would count the allocations of the idle parent.
+#define ManyProcessesStreamPipeline(num)                                       \
+  BENCHMARK_TEMPLATE_F(ManyProcesses, StreamPipeline_##num, num)               \
+  (benchmark::State & state) {                                                 \
+    for (auto _ : state)                                                       \
+      run();                                                                   \
+    auto elements = num_messages * static_cast<uint64_t>(state.iterations());  \
+    state.counters["elements/s"]                                               \
+      = benchmark::Counter(static_cast<double>(elements),                      \
+                           benchmark::Counter::kIsRate);                       \
+  }
+
+ManyProcessesStreamPipeline(0)
+ManyProcessesStreamPipeline(1)
+ManyProcessesStreamPipeline(2)
+ManyProcessesStreamPipeline(3)
+ManyProcessesStreamPipeline(4)
+
+int main(int argc, char** argv) {
+  if (auto spec = getenv(node_env_var))
+    return run_stream_node(spec);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return EXIT_FAILURE;
+  benchmark::RunSpecifiedBenchmarks();
+  return EXIT_SUCCESS;
+}
@@ -17,14 +17,21 @@
  * http://www.boost.org/LICENSE_1_0.txt.                                      *
  ******************************************************************************/
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
 #include <iostream>
+#include <mutex>
 
 #include "caf/all.hpp"
 
+#include "bench_args.hpp"
+#include "sample_stats.hpp"
+#include "thread_pinning.hpp"
+
 #if CAF_VERSION < 1800
 
 using calc_atom = caf::atom_constant<caf::atom("calc")>;
@@ -57,9 +64,39 @@ namespace {
 
 using factors = std::vector<uint64_t>;
 
-constexpr uint64_t s_factor1 = 86028157;
-constexpr uint64_t s_factor2 = 329545133;
-constexpr uint64_t s_task_n = s_factor1 * s_factor2;
+// The product of two primes that each worker factorizes once per ring. The
+// default has 55 bits, `--bits=N` selects a product of two primes with about
+// N / 2 bits each.
+uint64_t s_factor1 = 86028157;
+uint64_t s_factor2 = 329545133;
+uint64_t s_task_n = s_factor1 * s_factor2;
+
+bool is_prime(uint64_t n) {
+  if (n < 2)
+    return false;
+  for (uint64_t d = 2; d * d <= n; ++d)
+    if (n % d == 0)
+      return false;
+  return true;
+}
+
+/// Returns the largest prime below `n`.
+uint64_t prev_prime(uint64_t n) {
+  do {
+    --n;
+  } while (n > 2 && !is_prime(n));
+  return n;
+}
+
+/// Sets the task to the product of the two largest primes below 2^(bits / 2)
+/// and 2^((bits + 1) / 2).
+void set_task_bits(unsigned bits) {
+  s_factor1 = prev_prime(uint64_t{1} << (bits / 2));
+  s_factor2 = prev_prime(uint64_t{1} << ((bits + 1) / 2));
+  if (s_factor1 == s_factor2)
+    s_factor1 = prev_prime(s_factor1);
+  s_task_n = s_factor1 * s_factor2;
+}
 
 factors factorize(uint64_t n) {
   factors result;
@@ -80,6 +117,174 @@ factors factorize(uint64_t n) {
   return result;
 }
 
+// -- instrumentation ----------------------------------------------------------
+
+/// Enables per-handler and per-spawn timings (`--instrument=1`).
+bool s_instrument = false;
+
+int64_t steady_ns() {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+    .count();
+}
+
+/// Distribution and sum of durations in nanoseconds.
+struct timing {
+  log2_histogram hist;
+  std::atomic<int64_t> total_ns{0};
+
+  void add(int64_t ns) {
+    hist.add(ns);
+    total_ns.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  void print(const char* label) const {
+    log2_histogram::print(cout, label, hist.snapshot());
+    cout << "  total: " << total_ns.load() / 1000000 << " ms" << endl;
+  }
+};
+
+/// Timings per actor role and message type (handlers) and per actor type
+/// (spawns). Handler timings cover the handler body only, i.e., exclude the
+/// time a message spends in the mailbox as well as spawns in the handler.
+/// Links use lazy_init, i.e., initialize on their first message and have a
+/// separate timing for the initialization.
+struct timings {
+  timing master_token;
+  timing link_token;
+  timing worker_calc;
+  timing supervisor_result;
+  timing supervisor_done;
+  timing spawn_master;
+  timing spawn_link;
+  timing init_link;
+  timing spawn_worker;
+
+  void print() const {
+    cout << "handler times in ns:" << endl;
+    master_token.print("chain_master / token");
+    link_token.print("chain_link / token");
+    worker_calc.print("worker / calc");
+    supervisor_result.print("supervisor / factors");
+    supervisor_done.print("supervisor / done");
+    cout << "spawn times in ns:" << endl;
+    spawn_master.print("chain_master");
+    spawn_link.print("chain_link (lazy_init)");
+    init_link.print("chain_link initialization");
+    spawn_worker.print("worker (detached)");
+  }
+};
+
+timings s_timings;
+
+/// Enables measuring the worker busy time, i.e., the sum of all
+/// factorization times (`--bits=N`).
+bool s_measure_busy = false;
+
+std::atomic<int64_t> s_worker_busy_ns{0};
+
+/// Stamps every token with a value divisible by this number with the send
+/// time and the sending thread (`--hop-sample=N`), 0 disables sampling. Links
+/// forward the value unchanged, i.e., a sampled token stays sampled for one
+/// full round through the ring.
+uint64_t s_hop_sample = 0;
+
+/// Latency of sampled token hops, split by whether sender and receiver ran
+/// on the same thread. Keeps all samples for exact percentiles.
+struct hop_samples {
+  sample_set same_thread;
+  sample_set cross_thread;
+};
+
+/// Collects the hop samples of all threads. Each thread records into a
+/// thread-local `hop_samples` and merges it into this object when it
+/// terminates, i.e., when the actor system shuts down.
+struct hop_timings : hop_samples {
+  std::mutex mtx;
+
+  void merge(const hop_samples& xs) {
+    std::lock_guard<std::mutex> guard{mtx};
+    same_thread.merge(xs.same_thread);
+    cross_thread.merge(xs.cross_thread);
+  }
+
+  static void print(const char* label, sample_set& xs) {
+    cout << label << ": n = " << xs.size();
+    if (!xs.empty())
+      cout << ", min " << xs.percentile(0) << ", p50 " << xs.percentile(50)
+           << ", p90 " << xs.percentile(90) << ", p99 " << xs.percentile(99)
+           << ", max " << xs.percentile(100);
+    cout << endl;
+  }
+
+  void print() {
+    std::lock_guard<std::mutex> guard{mtx};
+    auto num_same = same_thread.size();
+    auto num_cross = cross_thread.size();
+    cout << "token hop latency in ns:" << endl;
+    print("same thread", same_thread);
+    print("cross thread", cross_thread);
+    if (num_same + num_cross > 0)
+      cout << "cross-thread hops: "
+           << 100.0 * num_cross / (num_same + num_cross) << "%" << endl;
+  }
+};
+
+hop_timings s_hops;
+
+struct local_hop_samples : hop_samples {
+  ~local_hop_samples() {
+    s_hops.merge(*this);
+  }
+};
+
+/// Returns a process-wide unique ID for the calling thread.
+uint64_t this_thread_id() {
+  static std::atomic<uint64_t> next_id{1};
+  thread_local uint64_t id = next_id++;
+  return id;
+}
+
+bool sampled(uint64_t value) {
+  return s_hop_sample > 0 && value % s_hop_sample == 0;
+}
+
+void record_hop(int64_t sent_ns, uint64_t sender_thread) {
+  thread_local local_hop_samples samples;
+  auto latency = steady_ns() - sent_ns;
+  if (sender_thread == this_thread_id())
+    samples.same_thread.add(latency);
+  else
+    samples.cross_thread.add(latency);
+}
+
+/// Adds the time between construction and destruction to a timing if
+/// instrumentation is enabled. A nested timing subtracts its time from the
+/// enclosing timing `outer`.
+class scoped_timing {
+public:
+  explicit scoped_timing(timing& x, scoped_timing* outer = nullptr)
+    : x_(x), outer_(outer), start_(s_instrument ? steady_ns() : 0) {
+    // nop
+  }
+
+  ~scoped_timing() {
+    if (s_instrument) {
+      auto ns = steady_ns() - start_;
+      x_.add(ns);
+      if (outer_ != nullptr)
+        outer_->start_ += ns;
+    }
+  }
+
+private:
+  timing& x_;
+  scoped_timing* outer_;
+  int64_t start_;
+};
+
+// -- actors -------------------------------------------------------------------
+
 inline void check_factors(const factors& vec) {
   assert(vec.size() == 2);
   assert(vec[0] == s_factor1);
@@ -91,24 +296,43 @@ inline void check_factors(const factors& vec) {
 
 behavior worker(event_based_actor* self) {
   return {
-    [](calc_atom, uint64_t what) { return factorize(what); },
+    [](calc_atom, uint64_t what) {
+      scoped_timing t{s_timings.worker_calc};
+      auto start = s_measure_busy ? steady_ns() : 0;
+      auto result = factorize(what);
+      if (s_measure_busy)
+        s_worker_busy_ns.fetch_add(steady_ns() - start,
+                                   std::memory_order_relaxed);
+      return result;
+    },
     [=](done_atom) { self->quit(); },
   };
 }
 
 behavior chain_link(event_based_actor* self, const actor& next) {
+  scoped_timing t{s_timings.init_link};
   return {
     [=](token_atom tk, uint64_t value) {
+      scoped_timing t{s_timings.link_token};
       if (value == 0)
         self->quit();
       self->delegate(next, tk, value);
     },
+    [=](token_atom tk, uint64_t value, int64_t sent_ns,
+        uint64_t sender_thread) {
+      record_hop(sent_ns, sender_thread);
+      scoped_timing t{s_timings.link_token};
+      if (value == 0)
+        self->quit();
+      self->delegate(next, tk, value, steady_ns(), this_thread_id());
+    },
   };
 }
 
 class chain_master : public event_based_actor {
 public:
-  chain_master(actor_config& cfg, actor coll, int rs, uint64_t itv, int n)
+  chain_master(actor_config& cfg, actor coll, actor factorizer, int rs,
+               uint64_t itv, int n)
     : event_based_actor(cfg),
       iteration_(0),
       ring_size_(rs),
@@ -116,37 +340,55 @@ public:
       num_iterations_(n),
       mc_(coll),
       next_(this),
-      factorizer_(spawn<detached>(worker)) {
+      factorizer_(factorizer) {
     // nop
   }
 
   behavior make_behavior() override {
     new_ring();
     return {
-      [=](token_atom tk, uint64_t value) {
-        if (value == 0) {
-          if (++iteration_ < num_iterations_) {
-            new_ring();
-          } else {
-            send(factorizer_, done_atom_v);
-            send(mc_, done_atom_v);
-            quit();
-          }
-        } else {
-          value -= 1;
-          delegate(next_, tk, value);
-        }
+      [=](token_atom tk, uint64_t value) { on_token(tk, value); },
+      [=](token_atom tk, uint64_t value, int64_t sent_ns,
+          uint64_t sender_thread) {
+        record_hop(sent_ns, sender_thread);
+        on_token(tk, value);
       },
     };
   }
 
 private:
-  void new_ring() {
+  void on_token(token_atom tk, uint64_t value) {
+    scoped_timing t{s_timings.master_token};
+    if (value == 0) {
+      if (++iteration_ < num_iterations_) {
+        new_ring(&t);
+      } else {
+        send(factorizer_, done_atom_v);
+        send(mc_, done_atom_v);
+        quit();
+      }
+    } else {
+      value -= 1;
+      if (sampled(value))
+        delegate(next_, tk, value, steady_ns(), this_thread_id());
+      else
+        delegate(next_, tk, value);
+    }
+  }
+
+  /// Spawns the links of a new ring, excluding the spawns from `outer`.
+  void new_ring(scoped_timing* outer = nullptr) {
     send_as(mc_, factorizer_, calc_atom_v, s_task_n);
     next_ = this;
-    for (int i = 1; i < ring_size_; ++i)
+    for (int i = 1; i < ring_size_; ++i) {
+      scoped_timing t{s_timings.spawn_link, outer};
       next_ = spawn<lazy_init>(chain_link, next_);
-    send(next_, token_atom_v, m_initial_token_value);
+    }
+    if (sampled(m_initial_token_value))
+      send(next_, token_atom_v, m_initial_token_value, steady_ns(),
+           this_thread_id());
+    else
+      send(next_, token_atom_v, m_initial_token_value);
   }
   int iteration_;
   int ring_size_;
@@ -167,11 +409,13 @@ public:
   behavior make_behavior() override {
     return {
       [=](const factors& vec) {
+        scoped_timing t{s_timings.supervisor_result};
         check_factors(vec);
         if (--left_ == 0)
           quit();
       },
       [=](done_atom) {
+        scoped_timing t{s_timings.supervisor_done};
         if (--left_ == 0)
           quit();
       },
@@ -185,9 +429,32 @@ private:
 } // namespace
 
 int main(int argc, char** argv) {
-  if (argc != 5) {
-    cout << "usage: mixed_case "
-            "NUM_RINGS RING_SIZE INITIAL_TOKEN_VALUE REPETITIONS\n\n";
+  pinning_policy pin;
+  if (auto str = take_arg(argc, argv, "instrument"))
+    s_instrument = *str == "1";
+  if (auto str = take_arg(argc, argv, "hop-sample"))
+    s_hop_sample = strtoull(str->c_str(), nullptr, 10);
+  auto bits = take_arg(argc, argv, "bits");
+  if (bits) {
+    auto n = atoi(bits->c_str());
+    if (n < 8 || n > 62) {
+      cout << "--bits must be in the range [8, 62]" << endl;
+      return 1;
+    }
+    set_task_bits(static_cast<unsigned>(n));
+    s_measure_busy = true;
+  }
+  if (!take_pinning_policy(argc, argv, pin) || argc != 5) {
+    cout << "usage: mixed_case [--pin=POLICY] [--instrument=1] "
+            "[--hop-sample=N] [--bits=N] "
+            "NUM_RINGS RING_SIZE INITIAL_TOKEN_VALUE REPETITIONS\n\n"
+         << pinning_usage
+         << "  --instrument=1  print handler and spawn times per actor role\n"
+         << "  --hop-sample=N  print the hop latency of every Nth token\n"
+         << "  --bits=N        factorize N-bit semiprimes (default: 55) and\n"
+         << "                  print the time of a single factorization and\n"
+         << "                  the sum of all factorization times (busy)\n"
+         << '\n';
     return 1;
   }
 #if CAF_VERSION >= 1800
@@ -198,11 +465,36 @@ int main(int argc, char** argv) {
   auto ring_size = atoi(argv[2]);
   auto initial_token_value = static_cast<uint64_t>(atoi(argv[3]));
   auto repetitions = atoi(argv[4]);
+  if (bits) {
+    // measure the compute cost per ring before starting any actor
+    auto start = steady_ns();
+    check_factors(factorize(s_task_n));
+    cout << "task: " << s_factor1 << " * " << s_factor2 << " = " << s_task_n
+         << endl
+         << "factorization: " << (steady_ns() - start) << " ns" << endl;
+  }
   actor_system_config cfg;
-  actor_system system{cfg};
-  auto sv = system.spawn<supervisor, lazy_init>(num_rings
-                                                + (num_rings * repetitions));
-  for (int i = 0; i < num_rings; ++i)
-    system.spawn<chain_master>(sv, ring_size, initial_token_value, repetitions);
+  add_pinning_hook(cfg, pin);
+  { // lifetime scope of the actor system
+    actor_system system{cfg};
+    auto sv = system.spawn<supervisor, lazy_init>(num_rings
+                                                  + (num_rings * repetitions));
+    for (int i = 0; i < num_rings; ++i) {
+      actor factorizer;
+      {
+        scoped_timing t{s_timings.spawn_worker};
+        factorizer = system.spawn<detached>(worker);
+      }
+      scoped_timing t{s_timings.spawn_master};
+      system.spawn<chain_master>(sv, factorizer, ring_size,
+                                 initial_token_value, repetitions);
+    }
+  }
+  if (s_measure_busy)
+    cout << "worker busy: " << s_worker_busy_ns.load() << " ns" << endl;
+  if (s_instrument)
+    s_timings.print();
+  if (s_hop_sample > 0)
+    s_hops.print();
 }
 
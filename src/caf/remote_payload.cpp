@@ -0,0 +1,788 @@
+/******************************************************************************
+ *                       ____    _    _____                                   *
+ *                      / ___|  / \  |  ___|    C++                           *
+ *                     | |     / _ \ | |_       Actor                         *
+ *                     | |___ / ___ \|  _|      Framework                     *
+ *                      \____/_/   \_|_|                                      *
+ *                                                                            *
+ * Copyright (C) 2011 - 2017                                                  *
+ * Dominik Charousset <dominik.charousset (at) haw-hamburg.de>                *
+ *                                                                            *
+ * Distributed under the terms and conditions of the BSD 3-Clause License or  *
+ * (at your option) under the terms and conditions of the Boost Software      *
+ * License 1.0. See accompanying files LICENSE and LICENSE_ALTERNATIVE.       *
+ *                                                                            *
+ * If you did not receive a copy of the license files, see                    *
+ * http://opensource.org/licenses/BSD-3-Clause and                            *
+ * http://www.boost.org/LICENSE_1_0.txt.                                      *
+ ******************************************************************************/
+
+// Sweeps payload sizes for remote messages between two CAF nodes on loopback.
+// The program forks an echo server and sends vectors, strings, and byte
+// buffers of increasing size to it. For each kind and size, it reports:
+// - throughput in messages and megabytes (payload only, one direction) per
+//   second with a fixed number of messages in flight
+// - round-trip time percentiles for a single message in flight
+// - heap allocations per round trip in the client and the server process,
+//   i.e., each side serializes one message and deserializes one message
+//
+// With --breakdown, the latency phase wraps each payload into a `timed`
+// object whose inspect overload takes timestamps while the middleman
+// serializes and deserializes it. Each side then attributes the round trip to
+// four stages per direction and prints them as histograms in nanoseconds:
+// - serialize: writing the payload on the sending side
+// - transmit: end of serialization to start of deserialization, i.e., time in
+//   the multiplexer, the socket and the receive buffers (both processes share
+//   the system-wide steady clock)
+// - deserialize: reading the payload on the receiving side
+// - dispatch: end of deserialization to entering the message handler
+//
+// With --backends=io,net, the program runs the same sweep once over the
+// classic io::middleman and once over caf.net and reports both in one table.
+// Since caf.net has no remote actors, the net backend wraps each payload into
+// a message and serializes it with a binary_serializer into a length-prefixed
+// frame. The server deserializes each frame into a message and serializes the
+// message again for the response via the flow API. Like with the io backend,
+// each side thus serializes and deserializes one payload per round trip. The
+// net backend requires CAF >= 0.19 with the caf.net module and does not
+// support --breakdown.
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "caf/all.hpp"
+#include "caf/io/all.hpp"
+
+#ifdef CAF_BENCH_ENABLE_NET
+#  include <future>
+#  include <optional>
+
+#  include "caf/async/blocking_consumer.hpp"
+#  include "caf/async/blocking_producer.hpp"
+#  include "caf/net/binary/frame.hpp"
+#  include "caf/net/lp/with.hpp"
+#  include "caf/net/middleman.hpp"
+#  include "caf/net/network_socket.hpp"
+#  include "caf/net/tcp_accept_socket.hpp"
+#endif
+
+#include "alloc_counter.hpp"
+#include "node_launcher.hpp"
+#include "sample_stats.hpp"
+#include "thread_pinning.hpp"
+
+#if CAF_VERSION < 1800
+#  error "remote_payload requires CAF >= 0.18"
+#endif
+
+template <class T>
+struct timed;
+
+CAF_BEGIN_TYPE_ID_BLOCK(remote_payload, first_custom_type_id)
+
+  CAF_ADD_TYPE_ID(remote_payload, (std::vector<uint64_t>) );
+  CAF_ADD_TYPE_ID(remote_payload, (timed<std::vector<uint64_t>>) );
+  CAF_ADD_TYPE_ID(remote_payload, (timed<std::string>) );
+  CAF_ADD_TYPE_ID(remote_payload, (timed<caf::byte_buffer>) );
+
+  CAF_ADD_ATOM(remote_payload, histogram_atom);
+
+CAF_END_TYPE_ID_BLOCK(remote_payload)
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+using namespace caf;
+
+using hrc = std::chrono::high_resolution_clock;
+
+namespace {
+
+struct params {
+  size_t min_size = 8;
+  size_t max_size = 4 * 1024 * 1024;
+  size_t window = 16;
+  size_t samples = 1000;
+  string kinds = "vector,string,bytes";
+  string backends = "io";
+  bool breakdown = false;
+};
+
+int usage() {
+  cout << "usage: remote_payload [OPTION]..." << endl
+       << endl
+       << "  --min-size=NUM   smallest payload in bytes (default: 8)" << endl
+       << "  --max-size=NUM   largest payload in bytes (default: 4 MB)" << endl
+       << "  --window=NUM     messages in flight for the throughput phase"
+       << endl
+       << "  --samples=NUM    round trips for the latency phase" << endl
+       << "  --kinds=LIST     comma-separated list of payload kinds" << endl
+       << "                   (vector,string,bytes)" << endl
+       << "  --breakdown=1    print per-stage histograms for the latency phase"
+       << endl
+       << "  --backends=LIST  comma-separated list of network backends" << endl
+       << "                   (io,net; default: io)" << endl
+       << pinning_usage << endl;
+  return EXIT_FAILURE;
+}
+
+template <class... Ts>
+int usage(const Ts&... xs) {
+  (cout << ... << xs) << endl << endl;
+  return usage();
+}
+
+struct config : actor_system_config {
+  config(pinning_policy pin) {
+    load<io::middleman>();
+#ifdef CAF_BENCH_ENABLE_NET
+    load<net::middleman>();
+#endif
+    add_pinning_hook(*this, pin);
+  }
+};
+
+// -- payloads -----------------------------------------------------------------
+
+template <class T>
+struct payload_trait;
+
+template <>
+struct payload_trait<vector<uint64_t>> {
+  static constexpr const char* name = "vector";
+  static vector<uint64_t> make(size_t size) {
+    return vector<uint64_t>(std::max(size / sizeof(uint64_t), size_t{1}), 42);
+  }
+};
+
+template <>
+struct payload_trait<string> {
+  static constexpr const char* name = "string";
+  static string make(size_t size) {
+    return string(size, 'x');
+  }
+};
+
+template <>
+struct payload_trait<byte_buffer> {
+  static constexpr const char* name = "bytes";
+  static byte_buffer make(size_t size) {
+    return byte_buffer(size, byte{0x2A});
+  }
+};
+
+// -- per-stage instrumentation ------------------------------------------------
+
+int64_t steady_ns() {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+    .count();
+}
+
+/// Stage histograms of this process for messages it receives (transmit,
+/// deserialize, dispatch) or sends (serialize).
+struct stage_histograms {
+  log2_histogram serialize;
+  log2_histogram transmit;
+  log2_histogram deserialize;
+  log2_histogram dispatch;
+
+  void reset() {
+    serialize.reset();
+    transmit.reset();
+    deserialize.reset();
+    dispatch.reset();
+  }
+};
+
+stage_histograms s_stages;
+
+/// Checks whether `Inspector` is one of the inspectors that the middleman
+/// uses for messages. Only these record samples, since printing a `timed`
+/// object, e.g., in log output, must not add to the histograms.
+template <class Inspector>
+constexpr bool is_wire_inspector
+  = std::is_same_v<Inspector, binary_serializer>
+    || std::is_same_v<Inspector, binary_deserializer>;
+
+/// Carries the time when the sender finished serializing a `timed` payload.
+/// The timestamp gets assigned while serializing, i.e., right after writing
+/// the payload.
+struct send_stamp {
+  /// Start of serialization (not serialized).
+  int64_t started = 0;
+  /// End of serialization.
+  int64_t value = 0;
+};
+
+template <class Inspector>
+bool inspect(Inspector& f, send_stamp& x) {
+  if constexpr (std::is_same_v<Inspector, binary_serializer>) {
+    x.value = steady_ns();
+    s_stages.serialize.add(x.value - x.started);
+  }
+  return f.object(x).fields(f.field("value", x.value));
+}
+
+/// Wraps a payload for measuring the time of each stage along its path.
+template <class T>
+struct timed {
+  T payload;
+  send_stamp stamp;
+  /// End of deserialization on the receiving side (not serialized).
+  int64_t deserialized_at = 0;
+};
+
+template <class Inspector, class T>
+bool inspect(Inspector& f, timed<T>& x) {
+  if constexpr (!is_wire_inspector<Inspector>) {
+    return f.object(x).fields(f.field("payload", x.payload),
+                              f.field("stamp", x.stamp));
+  } else if constexpr (Inspector::is_loading) {
+    auto t0 = steady_ns();
+    if (!f.object(x).fields(f.field("payload", x.payload),
+                            f.field("stamp", x.stamp)))
+      return false;
+    auto t1 = steady_ns();
+    s_stages.transmit.add(t0 - x.stamp.value);
+    s_stages.deserialize.add(t1 - t0);
+    x.deserialized_at = t1;
+    return true;
+  } else {
+    x.stamp.started = steady_ns();
+    return f.object(x).fields(f.field("payload", x.payload),
+                              f.field("stamp", x.stamp));
+  }
+}
+
+template <class T>
+void record_dispatch(const timed<T>& x) {
+  s_stages.dispatch.add(steady_ns() - x.deserialized_at);
+}
+
+template <class T>
+timed<T> bounce(timed<T>& x) {
+  record_dispatch(x);
+  return std::move(x);
+}
+
+// -- server -------------------------------------------------------------------
+
+behavior echo() {
+  return {
+    [](vector<uint64_t>& xs) { return std::move(xs); },
+    [](string& xs) { return std::move(xs); },
+    [](byte_buffer& xs) { return std::move(xs); },
+    [](timed<vector<uint64_t>>& x) { return bounce(x); },
+    [](timed<string>& x) { return bounce(x); },
+    [](timed<byte_buffer>& x) { return bounce(x); },
+    [](histogram_atom) {
+      return make_message(s_stages.serialize.snapshot(),
+                          s_stages.transmit.snapshot(),
+                          s_stages.deserialize.snapshot(),
+                          s_stages.dispatch.snapshot());
+    },
+    [](histogram_atom, reset_atom) { s_stages.reset(); },
+    [](get_atom) -> result<uint64_t, uint64_t> {
+      auto snapshot = alloc_counter::now();
+      return {snapshot.allocations, snapshot.allocated_bytes};
+    },
+  };
+}
+
+template <class F>
+int run_server(pinning_policy pin, F report) {
+  config cfg{pin};
+  actor_system sys{cfg};
+  auto server = sys.spawn(echo);
+  auto port = sys.middleman().publish(server, 0);
+  if (!port) {
+    cerr << "cannot publish echo server: " << to_string(port.error()) << endl;
+    anon_send_exit(server, exit_reason::user_shutdown);
+    return EXIT_FAILURE;
+  }
+  report(*port);
+  return EXIT_SUCCESS;
+}
+
+// -- reporting ----------------------------------------------------------------
+
+void print_header() {
+  cout << std::left << std::setw(8) << "backend" << std::setw(8) << "kind"
+       << std::right << std::setw(10) << "bytes" << std::setw(12) << "msgs/s"
+       << std::setw(10) << "MB/s" << std::setw(11) << "p50_us"
+       << std::setw(11) << "p99_us" << std::setw(11) << "p999_us"
+       << std::setw(14) << "client_allocs" << std::setw(14) << "server_allocs"
+       << endl;
+}
+
+/// Prints one row of the result table. A negative `server_allocs` means that
+/// the backend cannot query the server.
+void print_row(const char* backend, const char* kind, size_t size,
+               double msgs_per_sec, sample_set& rtt, double client_allocs,
+               double server_allocs) {
+  auto to_us = [](int64_t ns) { return ns / 1000.0; };
+  cout << std::left << std::setw(8) << backend << std::setw(8) << kind
+       << std::right << std::setw(10) << size << std::fixed
+       << std::setprecision(1) << std::setw(12) << msgs_per_sec
+       << std::setw(10) << msgs_per_sec * size / 1e6 << std::setprecision(2)
+       << std::setw(11) << to_us(rtt.percentile(50)) << std::setw(11)
+       << to_us(rtt.percentile(99)) << std::setw(11)
+       << to_us(rtt.percentile(99.9)) << std::setw(14) << client_allocs
+       << std::setw(14);
+  if (server_allocs >= 0)
+    cout << server_allocs << endl;
+  else
+    cout << "n/a" << endl;
+}
+
+/// Returns how many messages the throughput phase sends for `size` bytes.
+size_t throughput_messages(size_t size) {
+  return std::clamp((size_t{256} << 20) / size, size_t{100}, size_t{100000});
+}
+
+// -- client -------------------------------------------------------------------
+
+/// Returns the number of allocations in the server process.
+uint64_t server_allocations(scoped_actor& self, const actor& server) {
+  uint64_t result = 0;
+  self->request(server, infinite, get_atom_v)
+    .receive([&](uint64_t allocations, uint64_t) { result = allocations; },
+             [&](const error& err) {
+               cerr << "cannot query server: " << to_string(err) << endl;
+             });
+  return result;
+}
+
+/// Sends `payload` to `server` `samples` times with one message in flight and
+/// stores the round-trip times in `rtt`.
+template <class T>
+bool measure_rtt(scoped_actor& self, const actor& server, const T& payload,
+                 size_t samples, sample_set& rtt) {
+  auto ok = true;
+  rtt.reserve(samples);
+  for (size_t i = 0; i < samples && ok; ++i) {
+    auto t0 = hrc::now();
+    self->request(server, infinite, payload)
+      .receive(
+        [&](const T&) {
+          auto t1 = hrc::now();
+          rtt.add(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                    .count());
+        },
+        [&](const error& err) {
+          cerr << "request failed: " << to_string(err) << endl;
+          ok = false;
+        });
+  }
+  return ok;
+}
+
+template <class T>
+bool measure_rtt(scoped_actor& self, const actor& server,
+                 const timed<T>& payload, size_t samples, sample_set& rtt) {
+  auto ok = true;
+  rtt.reserve(samples);
+  for (size_t i = 0; i < samples && ok; ++i) {
+    auto t0 = hrc::now();
+    self->request(server, infinite, payload)
+      .receive(
+        [&](const timed<T>& x) {
+          record_dispatch(x);
+          auto t1 = hrc::now();
+          rtt.add(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                    .count());
+        },
+        [&](const error& err) {
+          cerr << "request failed: " << to_string(err) << endl;
+          ok = false;
+        });
+  }
+  return ok;
+}
+
+/// Prints the stage histograms of both directions. The server measures
+/// transmit, deserialize and dispatch for requests, the client for responses.
+void print_breakdown(scoped_actor& self, const actor& server) {
+  using buckets = log2_histogram::buckets;
+  self->request(server, infinite, histogram_atom_v)
+    .receive(
+      [&](const buckets& ser, const buckets& trans, const buckets& deser,
+          const buckets& disp) {
+        log2_histogram::print(cout, "  request  serialize   ",
+                              s_stages.serialize.snapshot());
+        log2_histogram::print(cout, "  request  transmit    ", trans);
+        log2_histogram::print(cout, "  request  deserialize ", deser);
+        log2_histogram::print(cout, "  request  dispatch    ", disp);
+        log2_histogram::print(cout, "  response serialize   ", ser);
+        log2_histogram::print(cout, "  response transmit    ",
+                              s_stages.transmit.snapshot());
+        log2_histogram::print(cout, "  response deserialize ",
+                              s_stages.deserialize.snapshot());
+        log2_histogram::print(cout, "  response dispatch    ",
+                              s_stages.dispatch.snapshot());
+      },
+      [&](const error& err) {
+        cerr << "cannot query histograms: " << to_string(err) << endl;
+      });
+}
+
+template <class T>
+bool run_step(scoped_actor& self, const actor& server, size_t size,
+              const params& ps) {
+  using trait = payload_trait<T>;
+  auto payload = trait::make(size);
+  // latency phase: one message in flight
+  sample_set rtt;
+  if (ps.breakdown) {
+    s_stages.reset();
+    self->request(server, infinite, histogram_atom_v, reset_atom_v)
+      .receive([] {}, [](const error&) {});
+    timed<T> wrapped{payload, {}, 0};
+    if (!measure_rtt(self, server, wrapped, ps.samples, rtt))
+      return false;
+  } else if (!measure_rtt(self, server, payload, ps.samples, rtt)) {
+    return false;
+  }
+  // throughput phase: `window` messages in flight
+  auto count = throughput_messages(size);
+  auto server_before = server_allocations(self, server);
+  auto client_before = alloc_counter::now().allocations;
+  auto start = hrc::now();
+  size_t sent = 0;
+  for (; sent < std::min(ps.window, count); ++sent)
+    self->send(server, payload);
+  size_t received = 0;
+  self->receive_for(received, count)([&](const T&) {
+    if (sent < count) {
+      self->send(server, payload);
+      ++sent;
+    }
+  });
+  auto stop = hrc::now();
+  auto client_after = alloc_counter::now().allocations;
+  auto server_after = server_allocations(self, server);
+  auto secs = std::chrono::duration<double>(stop - start).count();
+  print_row("io", trait::name, size, count / secs, rtt,
+            static_cast<double>(client_after - client_before) / count,
+            static_cast<double>(server_after - server_before) / count);
+  if (ps.breakdown)
+    print_breakdown(self, server);
+  return true;
+}
+
+template <class T>
+bool run_sweep(scoped_actor& self, const actor& server, const params& ps) {
+  for (auto size = ps.min_size; size <= ps.max_size; size *= 2)
+    if (!run_step<T>(self, server, size, ps))
+      return false;
+  return true;
+}
+
+bool run_client(actor_system& sys, uint16_t port, const params& ps) {
+  auto server = sys.middleman().remote_actor("127.0.0.1", port);
+  if (!server) {
+    cerr << "cannot connect to server: " << to_string(server.error()) << endl;
+    return false;
+  }
+  scoped_actor self{sys};
+  auto ok = true;
+  std::istringstream kinds{ps.kinds};
+  string kind;
+  while (ok && std::getline(kinds, kind, ',')) {
+    if (kind == "vector")
+      ok = run_sweep<vector<uint64_t>>(self, *server, ps);
+    else if (kind == "string")
+      ok = run_sweep<string>(self, *server, ps);
+    else if (kind == "bytes")
+      ok = run_sweep<byte_buffer>(self, *server, ps);
+    else
+      cerr << "unknown payload kind: " << kind << endl;
+  }
+  self->send_exit(*server, exit_reason::user_shutdown);
+  return ok;
+}
+
+// -- caf.net backend ----------------------------------------------------------
+
+#ifdef CAF_BENCH_ENABLE_NET
+
+using frame = net::binary::frame;
+
+/// Deserializes a message from `x` and serializes it again into a new frame.
+/// Returns an empty frame on error, which the client fails to deserialize.
+frame reencode(actor_system& sys, const frame& x) {
+  message msg;
+  binary_deserializer source{sys, x.bytes()};
+  if (!source.apply(msg)) {
+    cerr << "cannot deserialize frame: " << to_string(source.get_error())
+         << endl;
+    return frame{};
+  }
+  byte_buffer buf;
+  binary_serializer sink{sys, buf};
+  if (!sink.apply(msg)) {
+    cerr << "cannot serialize message: " << to_string(sink.get_error())
+         << endl;
+    return frame{};
+  }
+  return frame{make_span(buf)};
+}
+
+/// Echoes the messages of each connection. Returns after the first connection
+/// closed.
+template <class F>
+int run_net_server(pinning_policy pin, F report) {
+  config cfg{pin};
+  actor_system sys{cfg};
+  auto fd = net::make_tcp_accept_socket(uint16_t{0});
+  if (!fd) {
+    cerr << "cannot open accept socket: " << to_string(fd.error()) << endl;
+    return EXIT_FAILURE;
+  }
+  auto port = net::local_port(*fd);
+  if (!port) {
+    cerr << "cannot get port: " << to_string(port.error()) << endl;
+    return EXIT_FAILURE;
+  }
+  std::promise<void> closed;
+  auto on_start = [&](net::acceptor_resource<frame> events) {
+    sys.spawn([events, &closed](event_based_actor* self) {
+      events.observe_on(self).for_each(
+        [self, &closed](const net::accept_event<frame>& event) {
+          auto [pull, push] = event.data();
+          pull.observe_on(self)
+            .map([self](const frame& x) { return reencode(self->system(), x); })
+            .do_finally([&closed] { closed.set_value(); })
+            .subscribe(push);
+        });
+    });
+  };
+  auto server = net::lp::with(sys).accept(*fd).start(on_start);
+  if (!server) {
+    cerr << "cannot start server: " << to_string(server.error()) << endl;
+    return EXIT_FAILURE;
+  }
+  report(*port);
+  closed.get_future().wait();
+  server->dispose();
+  return EXIT_SUCCESS;
+}
+
+/// Blocking access to the frames of a single caf.net connection.
+struct net_connection {
+  std::optional<async::blocking_consumer<frame>> in;
+  std::optional<async::blocking_producer<frame>> out;
+  byte_buffer buf;
+
+  template <class T>
+  bool send(actor_system& sys, const T& payload) {
+    buf.clear();
+    binary_serializer sink{sys, buf};
+    return sink.apply(make_message(payload))
+           && out->push(frame{make_span(buf)});
+  }
+
+  template <class T>
+  bool receive(actor_system& sys, T& payload) {
+    frame x;
+    if (in->pull(async::delay_errors, x) != async::read_result::ok)
+      return false;
+    binary_deserializer source{sys, x.bytes()};
+    message msg;
+    if (!source.apply(msg) || !msg.match_elements<T>())
+      return false;
+    payload = std::move(msg.get_mutable_as<T>(0));
+    return true;
+  }
+};
+
+template <class T>
+bool run_net_step(actor_system& sys, net_connection& conn, size_t size,
+                  const params& ps) {
+  using trait = payload_trait<T>;
+  auto payload = trait::make(size);
+  T response;
+  // latency phase: one message in flight
+  sample_set rtt;
+  rtt.reserve(ps.samples);
+  for (size_t i = 0; i < ps.samples; ++i) {
+    auto t0 = hrc::now();
+    if (!conn.send(sys, payload) || !conn.receive(sys, response)) {
+      cerr << "connection to echo server failed" << endl;
+      return false;
+    }
+    auto t1 = hrc::now();
+    rtt.add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+  }
+  // throughput phase: `window` messages in flight
+  auto count = throughput_messages(size);
+  auto client_before = alloc_counter::now().allocations;
+  auto start = hrc::now();
+  size_t sent = 0;
+  for (; sent < std::min(ps.window, count); ++sent)
+    if (!conn.send(sys, payload))
+      return false;
+  for (size_t received = 0; received < count; ++received) {
+    if (!conn.receive(sys, response))
+      return false;
+    if (sent < count) {
+      if (!conn.send(sys, payload))
+        return false;
+      ++sent;
+    }
+  }
+  auto stop = hrc::now();
+  auto client_after = alloc_counter::now().allocations;
+  auto secs = std::chrono::duration<double>(stop - start).count();
+  print_row("net", trait::name, size, count / secs, rtt,
+            static_cast<double>(client_after - client_before) / count, -1);
+  return true;
+}
+
+template <class T>
+bool run_net_sweep(actor_system& sys, net_connection& conn, const params& ps) {
+  for (auto size = ps.min_size; size <= ps.max_size; size *= 2)
+    if (!run_net_step<T>(sys, conn, size, ps))
+      return false;
+  return true;
+}
+
+bool run_net_client(actor_system& sys, uint16_t port, const params& ps) {
+  async::consumer_resource<frame> pull;
+  async::producer_resource<frame> push;
+  auto conn_hdl = net::lp::with(sys)
+                    .connect(string{"127.0.0.1"}, port)
+                    .start([&](auto in, auto out) {
+                      pull = std::move(in);
+                      push = std::move(out);
+                    });
+  if (!conn_hdl) {
+    cerr << "cannot connect to server: " << to_string(conn_hdl.error())
+         << endl;
+    return false;
+  }
+  net_connection conn;
+  conn.in = async::make_blocking_consumer(std::move(pull));
+  conn.out = async::make_blocking_producer(std::move(push));
+  if (!conn.in || !conn.out) {
+    cerr << "cannot open connection buffers" << endl;
+    return false;
+  }
+  auto ok = true;
+  std::istringstream kinds{ps.kinds};
+  string kind;
+  while (ok && std::getline(kinds, kind, ',')) {
+    if (kind == "vector")
+      ok = run_net_sweep<vector<uint64_t>>(sys, conn, ps);
+    else if (kind == "string")
+      ok = run_net_sweep<string>(sys, conn, ps);
+    else if (kind == "bytes")
+      ok = run_net_sweep<byte_buffer>(sys, conn, ps);
+    else
+      cerr << "unknown payload kind: " << kind << endl;
+  }
+  // closing our end of the connection shuts down the server
+  conn.out->close();
+  conn.in->cancel();
+  return ok;
+}
+
+#endif // CAF_BENCH_ENABLE_NET
+
+/// Forks an echo server for `backend`, runs the sweep against it and waits
+/// for the server to terminate.
+bool run_backend(pinning_policy pin, const string& backend, const params& ps) {
+  auto use_net = backend == "net";
+  // fork the server before starting any thread in this process
+  auto child = fork_node([pin, use_net](auto report) {
+#ifdef CAF_BENCH_ENABLE_NET
+    if (use_net)
+      return run_net_server(pin, report);
+#endif
+    static_cast<void>(use_net);
+    return run_server(pin, report);
+  });
+  if (child.port == 0) {
+    cerr << "failed to launch echo server" << endl;
+    wait_for(child);
+    return false;
+  }
+  auto ok = false;
+  {
+    config cfg{pin};
+    actor_system sys{cfg};
+#ifdef CAF_BENCH_ENABLE_NET
+    if (use_net)
+      ok = run_net_client(sys, child.port, ps);
+    else
+#endif
+      ok = run_client(sys, child.port, ps);
+  }
+  if (!ok)
+    kill(child.pid, SIGKILL);
+  wait_for(child);
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  init_global_meta_objects<id_block::remote_payload>();
+  io::middleman::init_global_meta_objects();
+#ifdef CAF_BENCH_ENABLE_NET
+  net::middleman::init_global_meta_objects();
+#endif
+  core::init_global_meta_objects();
+  pinning_policy pin;
+  if (!take_pinning_policy(argc, argv, pin))
+    return usage();
+  params ps;
+  auto take_size = [&](const char* name, size_t& x) {
+    if (auto str = take_arg(argc, argv, name))
+      x = static_cast<size_t>(std::stoull(*str));
+  };
+  take_size("min-size", ps.min_size);
+  take_size("max-size", ps.max_size);
+  take_size("window", ps.window);
+  take_size("samples", ps.samples);
+  if (auto str = take_arg(argc, argv, "kinds"))
+    ps.kinds = *str;
+  if (auto str = take_arg(argc, argv, "breakdown"))
+    ps.breakdown = *str != "0";
+  if (auto str = take_arg(argc, argv, "backends"))
+    ps.backends = *str;
+  if (argc != 1 || ps.min_size == 0 || ps.window == 0)
+    return usage();
+  vector<string> backends;
+  std::istringstream backends_str{ps.backends};
+  for (string backend; std::getline(backends_str, backend, ',');) {
+#ifdef CAF_BENCH_ENABLE_NET
+    if (backend == "net" && ps.breakdown)
+      cerr << "note: --breakdown has no effect for the net backend" << endl;
+#else
+    if (backend == "net")
+      return usage("this build has no support for caf.net (needs CAF 0.19)");
+#endif
+    if (backend != "io" && backend != "net")
+      return usage("unknown backend: ", backend);
+    backends.emplace_back(std::move(backend));
+  }
+  print_header();
+  for (auto& backend : backends)
+    if (!run_backend(pin, backend, ps))
+      return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
@@ -19,9 +19,15 @@
 
 #include <vector>
 #include <chrono>
+#include <cmath>
+#include <random>
+#include <cstdint>
+#include <algorithm>
 
 #include "caf/all.hpp"
 
+#include "thread_pinning.hpp"
+
 #if CAF_VERSION < 1800
 
 using task_atom = caf::atom_constant<caf::atom("task")>;
@@ -57,6 +63,13 @@ auto ms(T x, T y) -> decltype(duration_cast<milliseconds>(y - x).count()) {
 
 using hrc = high_resolution_clock;
 
+namespace {
+
+/// Seed for all randomized workloads.
+uint64_t s_seed = 0;
+
+} // namespace
+
 behavior task_worker(event_based_actor* self) {
   aout(self) << self->id() << " task_worker_" << self->id() << std::endl;
   return {
@@ -99,6 +112,236 @@ behavior recursive_worker(event_based_actor* self, actor parent) {
   };
 }
 
+// -- randomized task graphs ---------------------------------------------------
+
+/// Performs `units` rounds of busy work.
+void burn(uint64_t units) {
+  volatile uint64_t sink = 0;
+  for (uint64_t i = 0; i < units * 1000; ++i)
+    sink = sink + i;
+}
+
+/// Returns the average time of a single `burn` unit in nanoseconds.
+double ns_per_unit() {
+  constexpr uint64_t probe = 10000;
+  auto t0 = hrc::now();
+  burn(probe);
+  auto t1 = hrc::now();
+  return static_cast<double>(duration_cast<nanoseconds>(t1 - t0).count())
+         / probe;
+}
+
+/// A single node in a task graph.
+struct dag_task {
+  /// Work in `burn` units.
+  uint64_t work;
+  /// Number of tasks that must finish before this task can run.
+  size_t num_predecessors = 0;
+  /// Indexes of all tasks that depend on this task.
+  std::vector<size_t> successors;
+};
+
+/// A task graph in topological order, i.e., each task has a larger index than
+/// all of its predecessors.
+using dag = std::vector<dag_task>;
+
+size_t add_task(dag& g, uint64_t work) {
+  g.emplace_back();
+  g.back().work = work;
+  return g.size() - 1;
+}
+
+void add_edge(dag& g, size_t from, size_t to) {
+  g[from].successors.push_back(to);
+  ++g[to].num_predecessors;
+}
+
+/// Returns the length of the longest path through `g` in work units.
+uint64_t critical_path(const dag& g) {
+  std::vector<uint64_t> finish(g.size(), 0);
+  uint64_t result = 0;
+  for (size_t i = 0; i < g.size(); ++i) {
+    // finish[i] holds the earliest start time until we add the task's work
+    finish[i] += g[i].work;
+    for (auto j : g[i].successors)
+      finish[j] = std::max(finish[j], finish[i]);
+    result = std::max(result, finish[i]);
+  }
+  return result;
+}
+
+uint64_t total_work(const dag& g) {
+  uint64_t result = 0;
+  for (auto& t : g)
+    result += t.work;
+  return result;
+}
+
+/// Grows a fork-join subtree and returns its entry and exit task. Each node
+/// either continues a chain with a single child or forks into a wide fan-out
+/// that a dedicated task joins again.
+std::pair<size_t, size_t> grow_tree(dag& g, std::mt19937_64& rng,
+                                    size_t depth, size_t max_tasks) {
+  std::uniform_int_distribution<uint64_t> work{1, 100};
+  std::uniform_int_distribution<size_t> width{2, 16};
+  std::bernoulli_distribution fork{0.15};
+  auto entry = add_task(g, work(rng));
+  if (depth == 0 || g.size() >= max_tasks)
+    return {entry, entry};
+  if (!fork(rng)) {
+    auto [first, last] = grow_tree(g, rng, depth - 1, max_tasks);
+    add_edge(g, entry, first);
+    return {entry, last};
+  }
+  std::vector<size_t> exits;
+  for (auto n = width(rng); n > 0; --n) {
+    auto [first, last] = grow_tree(g, rng, depth - 1, max_tasks);
+    add_edge(g, entry, first);
+    exits.push_back(last);
+  }
+  auto join = add_task(g, 1);
+  for (auto x : exits)
+    add_edge(g, x, join);
+  return {entry, join};
+}
+
+/// Generates an unbalanced fork-join tree with deep chains and wide fan-outs.
+dag skewed_tree(std::mt19937_64& rng) {
+  dag g;
+  grow_tree(g, rng, 24, 50000);
+  return g;
+}
+
+/// Generates a layered DAG where each task joins 1 to 4 tasks of the previous
+/// layer and occasionally depends on a task from an older layer.
+dag layered_dag(std::mt19937_64& rng) {
+  constexpr size_t num_layers = 64;
+  std::uniform_int_distribution<uint64_t> work{1, 100};
+  std::uniform_int_distribution<size_t> width{1, 128};
+  std::uniform_int_distribution<size_t> fan_in{1, 4};
+  std::bernoulli_distribution skip{0.1};
+  dag g;
+  size_t prev_begin = 0;
+  size_t prev_end = add_task(g, work(rng)) + 1;
+  for (size_t layer = 1; layer < num_layers; ++layer) {
+    auto begin = g.size();
+    for (auto n = width(rng); n > 0; --n) {
+      auto task = add_task(g, work(rng));
+      std::uniform_int_distribution<size_t> prev{prev_begin, prev_end - 1};
+      std::vector<size_t> preds;
+      for (auto k = fan_in(rng); k > 0; --k)
+        preds.push_back(prev(rng));
+      if (prev_begin > 0 && skip(rng))
+        preds.push_back(
+          std::uniform_int_distribution<size_t>{0, prev_begin - 1}(rng));
+      std::sort(preds.begin(), preds.end());
+      preds.erase(std::unique(preds.begin(), preds.end()), preds.end());
+      for (auto p : preds)
+        add_edge(g, p, task);
+    }
+    prev_begin = begin;
+    prev_end = g.size();
+  }
+  return g;
+}
+
+/// Generates a flat fork-join with long-tail task sizes drawn from a Pareto
+/// distribution (alpha = 1.5, minimum of 1 unit, capped at 20000 units).
+dag pareto_farm(std::mt19937_64& rng) {
+  constexpr size_t num_tasks = 10000;
+  constexpr double alpha = 1.5;
+  std::uniform_real_distribution<double> uniform{0.0, 1.0};
+  dag g;
+  auto root = add_task(g, 1);
+  std::vector<size_t> tasks;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    auto x = 1.0 / std::pow(1.0 - uniform(rng), 1.0 / alpha);
+    tasks.push_back(add_task(g, static_cast<uint64_t>(std::min(x, 20000.0))));
+    add_edge(g, root, tasks.back());
+  }
+  auto join = add_task(g, 1);
+  for (auto t : tasks)
+    add_edge(g, t, join);
+  return g;
+}
+
+/// Runs a single task of a DAG after all of its predecessors have finished.
+class dag_node : public event_based_actor {
+public:
+  dag_node(actor_config& cfg, uint64_t work, size_t pending,
+           std::vector<actor> successors, actor listener)
+    : event_based_actor(cfg),
+      work_(work),
+      pending_(pending),
+      successors_(std::move(successors)),
+      listener_(std::move(listener)) {
+    // nop
+  }
+
+  behavior make_behavior() override {
+    return {
+      [=](task_atom) {
+        if (--pending_ > 0)
+          return;
+        burn(work_);
+        if (successors_.empty())
+          send(listener_, result_atom_v, uint32_t{1});
+        for (auto& x : successors_)
+          send(x, task_atom_v);
+        quit();
+      },
+    };
+  }
+
+private:
+  uint64_t work_;
+  size_t pending_;
+  std::vector<actor> successors_;
+  actor listener_;
+};
+
+/// Executes `g` with one actor per task and prints the makespan next to the
+/// critical-path lower bound.
+void run_dag(actor_system& system, const char* name, const dag& g) {
+  auto unit_ns = ns_per_unit();
+  scoped_actor self{system};
+  std::vector<actor> nodes(g.size());
+  size_t num_sinks = 0;
+  for (auto i = g.size(); i > 0; --i) {
+    auto& t = g[i - 1];
+    std::vector<actor> successors;
+    for (auto j : t.successors)
+      successors.push_back(nodes[j]);
+    if (successors.empty())
+      ++num_sinks;
+    nodes[i - 1] = system.spawn<dag_node, lazy_init>(
+      t.work, std::max(t.num_predecessors, size_t{1}), std::move(successors),
+      actor{self});
+  }
+  auto start = hrc::now();
+  for (size_t i = 0; i < g.size(); ++i)
+    if (g[i].num_predecessors == 0)
+      anon_send(nodes[i], task_atom_v);
+  nodes.clear();
+  size_t finished = 0;
+  self->receive_for(finished, num_sinks)([](result_atom, uint32_t) {
+    // nop
+  });
+  auto makespan = duration_cast<microseconds>(hrc::now() - start).count();
+  auto threads = system.scheduler().num_workers();
+  auto cp = critical_path(g);
+  auto work = total_work(g);
+  auto bound_units = std::max(cp, work / threads);
+  auto bound = static_cast<int64_t>(bound_units * unit_ns / 1000);
+  std::cout << name << ": tasks = " << g.size() << ", total work = " << work
+            << " units, critical path = " << cp << " units, unit = "
+            << unit_ns << " ns\n"
+            << name << ": makespan = " << makespan
+            << " us, lower bound = " << bound << " us, ratio = "
+            << (bound > 0 ? static_cast<double>(makespan) / bound : 0.0)
+            << std::endl;
+}
+
 bool mandatory_missing(const settings& conf,
                        std::initializer_list<std::string> xs) {
   auto not_in_conf = [&](const std::string& x) {
@@ -117,6 +360,7 @@ bool setup(int argc, char** argv, std::string& labels_output_file,
   size_t profiler_resolution_ms = 100;
   size_t scheduler_threads = std::thread::hardware_concurrency();
   size_t max_msg_per_run = std::numeric_limits<size_t>::max();
+  std::string pin = "none";
   config_option_set options;
   config_option_adder{options, "global"}
     .add<bool>("help,h?", "print this help text")
@@ -126,7 +370,9 @@ bool setup(int argc, char** argv, std::string& labels_output_file,
     .add(profiler_resolution_ms, "resolution,r", "profiler resolution in ms")
     .add(scheduler_threads, "threads,t", "number of threads for the scheduler")
     .add(max_msg_per_run, "max-msgs,m", "number of messages per actor run")
-    .add(workload, "workload,w", "select workload to bench (1-10) (mandatory)");
+    .add(workload, "workload,w", "select workload to bench (0-8) (mandatory)")
+    .add(s_seed, "seed,s", "seed for randomized workloads (6-8)")
+    .add(pin, "pin", "pin scheduler workers (none|compact|scatter|physical)");
   settings conf;
   auto res = options.parse(conf, {argv + 1, argv + argc});
   if (res.first != caf::pec::success) {
@@ -145,8 +391,14 @@ bool setup(int argc, char** argv, std::string& labels_output_file,
   cfg.set("scheduler.profiling-resolution", timespan{profiler_resolution});
   cfg.set("scheduler.max-threads", scheduler_threads);
   cfg.set("scheduler.max_throughput", max_msg_per_run);
-  if (workload < 0 || workload > 5)
+  if (workload < 0 || workload > 8)
+    return false;
+  pinning_policy policy;
+  if (!from_string(pin, policy)) {
+    std::cerr << "unknown pinning policy: " << pin << std::endl;
     return false;
+  }
+  add_pinning_hook(cfg, policy);
   return true;
 }
 
@@ -254,6 +506,25 @@ void impl6(actor_system& system) {
   }
 }
 
+/// Run a seeded, unbalanced fork-join tree with deep chains that spawn wide
+/// fan-outs.
+void impl7(actor_system& system) {
+  std::mt19937_64 rng{s_seed};
+  run_dag(system, "skewed_tree", skewed_tree(rng));
+}
+
+/// Run a seeded, layered DAG with join dependencies across layers.
+void impl8(actor_system& system) {
+  std::mt19937_64 rng{s_seed};
+  run_dag(system, "layered_dag", layered_dag(rng));
+}
+
+/// Run a seeded fork-join of 10000 tasks with Pareto-distributed sizes.
+void impl9(actor_system& system) {
+  std::mt19937_64 rng{s_seed};
+  run_dag(system, "pareto_farm", pareto_farm(rng));
+}
+
 int main(int argc, char** argv) {
 #if CAF_VERSION >= 1800
   caf::init_global_meta_objects<caf::id_block::scheduling>();
@@ -267,6 +538,7 @@ int main(int argc, char** argv) {
   actor_system system(cfg);
   actor_ostream::redirect_all(system, labels_output_file);
   using implfun = void (*)(actor_system&);
-  implfun funs[] = {impl1, impl2, impl3, impl4, impl5, impl6};
+  implfun funs[] = {impl1, impl2, impl3, impl4, impl5, impl6,
+                    impl7, impl8, impl9};
   funs[workload](system);
 }
@@ -0,0 +1,73 @@
+// Forwards TCP connections from a local port to a target while injecting
+// delay, jitter and a bandwidth cap, e.g., for running distributed benchmarks
+// over loopback with datacenter-like round-trip times:
+//
+//   tcp_relay --target=127.0.0.1:8000 --shape=delay=250us,rate=10gbit
+//
+// Runs until receiving SIGINT or SIGTERM.
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "bench_args.hpp"
+#include "tcp_relay.hpp"
+
+using namespace std;
+
+int usage() {
+  cerr << "usage: tcp_relay --target=HOST:PORT [--listen=PORT] [--shape=SPEC]"
+       << endl
+       << endl
+       << "  --target=HOST:PORT  forward all connections to HOST:PORT" << endl
+       << "  --listen=PORT       accept connections on PORT (default: pick a"
+       << endl
+       << "                      free port and print it)" << endl
+       << "  --shape=SPEC        comma-separated list of:" << endl
+       << "                        delay=DURATION   one-way delay" << endl
+       << "                        jitter=DURATION  max. deviation from delay"
+       << endl
+       << "                        rate=RATE        bandwidth per direction"
+       << endl
+       << "                        chunk=BYTES      max. bytes per chunk"
+       << endl
+       << "                      with DURATION in us|ms|s and RATE in "
+          "kbit|mbit|gbit"
+       << endl;
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char** argv) {
+  auto target = take_arg(argc, argv, "target");
+  if (!target || argc > 4)
+    return usage();
+  auto sep = target->rfind(':');
+  if (sep == string::npos)
+    return usage();
+  auto host = target->substr(0, sep);
+  auto port = atoi(target->c_str() + sep + 1);
+  int listen_port = 0;
+  if (auto str = take_arg(argc, argv, "listen"))
+    listen_port = atoi(str->c_str());
+  shaping cfg;
+  if (auto str = take_arg(argc, argv, "shape"))
+    if (!parse_shaping(*str, cfg))
+      return usage();
+  if (argc > 1 || port <= 0 || port >= 65536 || listen_port < 0
+      || listen_port >= 65536)
+    return usage();
+  // block the signals before starting the relay thread
+  sigset_t sigs;
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGINT);
+  sigaddset(&sigs, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
+  tcp_relay relay{cfg, host, static_cast<uint16_t>(port)};
+  if (relay.start(static_cast<uint16_t>(listen_port)) == 0)
+    return EXIT_FAILURE;
+  cout << "relaying 127.0.0.1:" << relay.port() << " to " << *target << endl;
+  int sig = 0;
+  sigwait(&sigs, &sig);
+  return EXIT_SUCCESS;
+}